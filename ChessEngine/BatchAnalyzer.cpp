@@ -0,0 +1,187 @@
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "BatchAnalyzer.h"
+#include "ChessEngine.h"
+#include "Memory.h"
+
+BatchAnalyzer::BatchAnalyzer(BatchOptions options) : options(options) {
+    if (this->options.numThreads < 1) {
+        this->options.numThreads = 1;
+    }
+    maxQueuedJobs = 4 * this->options.numThreads;
+}
+
+std::string BatchAnalyzer::lineToFEN(const std::string& line, std::string& outId) {
+    outId = "";
+    std::stringstream lineStream(line);
+    std::string fields[6];
+    int numFields = 0;
+    while (numFields < 6 && lineStream >> fields[numFields]) {
+        numFields++;
+    }
+    if (numFields < 4) {
+        return "";
+    }
+
+    std::string fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+    bool hasMoveCounters = numFields == 6 &&
+        fields[4].find_first_not_of("0123456789") == std::string::npos &&
+        fields[5].find_first_not_of("0123456789") == std::string::npos;
+    if (hasMoveCounters) {
+        return fen + " " + fields[4] + " " + fields[5];
+    }
+
+    // EPD operations, ex: bm Nf3; id "position 1";
+    size_t idStart = line.find(" id ");
+    if (idStart != std::string::npos) {
+        size_t valueStart = line.find_first_not_of(' ', idStart + 4);
+        size_t valueEnd = line.find(';', valueStart);
+        outId = line.substr(valueStart, valueEnd == std::string::npos ? std::string::npos : valueEnd - valueStart);
+        if (outId.size() >= 2 && outId.front() == '"' && outId.back() == '"') {
+            outId = outId.substr(1, outId.size() - 2);
+        }
+    }
+    return fen + " 0 1";
+}
+
+void BatchAnalyzer::pushJob(Job job) {
+    std::unique_lock<std::mutex> lock(jobsMutex);
+    jobsNotFull.wait(lock, [this] { return jobs.size() < maxQueuedJobs; });
+    jobs.push_back(std::move(job));
+    jobsNotEmpty.notify_one();
+}
+
+bool BatchAnalyzer::popJob(Job& job) {
+    std::unique_lock<std::mutex> lock(jobsMutex);
+    jobsNotEmpty.wait(lock, [this] { return !jobs.empty() || inputDone; });
+    if (jobs.empty()) {
+        return false;
+    }
+    job = std::move(jobs.front());
+    jobs.pop_front();
+    jobsNotFull.notify_one();
+    return true;
+}
+
+void BatchAnalyzer::workerLoop(int threadIdx) {
+    // bind before the engine exists so its transposition table is placed near the thread
+    Memory::bindThread(threadIdx);
+    ChessEngine engine;
+    Job job;
+    while (popJob(job)) {
+        // a malformed line is reported instead of ending the whole run
+        try {
+            engine.loadFEN(job.fen);
+        }
+        catch (const std::exception&) {
+            writeResult(job, "(invalid)", 0, 0, 0);
+            continue;
+        }
+        if (engine.board.countPieces(Player::WHITE, Piece::KING) != 1 || engine.board.countPieces(Player::BLACK, Piece::KING) != 1) {
+            writeResult(job, "(invalid)", 0, 0, 0);
+            continue;
+        }
+        if (engine.board.generateAllLegalMoves().empty()) {
+            // checkmate or stalemate, nothing to search
+            writeResult(job, "(none)", 0, 0, 0);
+            continue;
+        }
+        Move m = engine.search(options.depth);
+        writeResult(job, Moves::toString(m), engine.getLastEval(), options.depth, engine.getStats().nodes);
+    }
+}
+
+std::string BatchAnalyzer::quote(const std::string& s, bool json) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"') {
+            out += json ? "\\\"" : "\"\"";
+        }
+        else if (c == '\\' && json) {
+            out += "\\\\";
+        }
+        else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void BatchAnalyzer::writeResult(const Job& job, const std::string& bestMove, int score, int depth, uint64_t nodes) {
+    std::stringstream line;
+    if (options.jsonl) {
+        line << "{\"index\":" << job.index << ",\"id\":" << quote(job.id, true) << ",\"fen\":" << quote(job.fen, true)
+             << ",\"bestmove\":\"" << bestMove << "\",\"score\":" << score << ",\"depth\":" << depth
+             << ",\"nodes\":" << nodes << "}\n";
+    }
+    else {
+        line << job.index << "," << quote(job.id, false) << "," << job.fen << "," << bestMove << ","
+             << score << "," << depth << "," << nodes << "\n";
+    }
+
+    std::lock_guard<std::mutex> lock(outMutex);
+    *out << line.str();
+}
+
+void BatchAnalyzer::run() {
+    std::ifstream inFile;
+    std::istream* in = &std::cin;
+    if (!options.inputPath.empty()) {
+        inFile.open(options.inputPath);
+        if (!inFile) {
+            std::cerr << "could not open " << options.inputPath << std::endl;
+            return;
+        }
+        in = &inFile;
+    }
+
+    std::ofstream outFile;
+    out = &std::cout;
+    if (!options.outputPath.empty()) {
+        outFile.open(options.outputPath);
+        if (!outFile) {
+            std::cerr << "could not open " << options.outputPath << std::endl;
+            return;
+        }
+        out = &outFile;
+    }
+
+    if (!options.jsonl) {
+        *out << "index,id,fen,bestmove,score,depth,nodes\n";
+    }
+
+    // initialize shared tables before any worker constructs an engine
+    Bitboards::initPieceMoveBoards();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.numThreads; i++) {
+        workers.push_back(std::thread(&BatchAnalyzer::workerLoop, this, i));
+    }
+
+    std::string line;
+    uint64_t index = 0;
+    while (std::getline(*in, line)) {
+        Job job = { index, "", "" };
+        job.fen = lineToFEN(line, job.id);
+        index++;
+        if (!job.fen.empty()) {
+            pushJob(std::move(job));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        inputDone = true;
+    }
+    jobsNotEmpty.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    out->flush();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+/***
+ * Settings for a batch analysis run
+ */
+struct BatchOptions {
+    std::string inputPath;   // EPD/FEN file to read, stdin if empty
+    std::string outputPath;  // file to write results to, stdout if empty
+    int numThreads = 1;
+    int depth = 5;
+    bool jsonl = false;      // write JSON lines instead of CSV
+};
+
+/***
+ * Analyzes a stream of positions (one EPD or FEN per line) across a pool of threads.
+ * Each worker owns its own engine, so no search state is shared between threads.
+ *
+ * Positions are read lazily into a bounded queue and results are written as soon as they
+ * are available, so memory use does not depend on the size of the input. Results are
+ * written in the order they finish, each tagged with the line index of its position.
+ * Positions that can't be loaded are written with the best move "(invalid)".
+ */
+class BatchAnalyzer
+{
+private:
+    struct Job {
+        uint64_t index;
+        std::string fen;
+        std::string id;
+    };
+
+    BatchOptions options;
+
+    // bounded queue of positions waiting to be analyzed
+    std::deque<Job> jobs;
+    size_t maxQueuedJobs;
+    bool inputDone = false;
+    std::mutex jobsMutex;
+    std::condition_variable jobsNotEmpty;
+    std::condition_variable jobsNotFull;
+
+    std::ostream* out = nullptr;
+    std::mutex outMutex;
+
+    /***
+     * Adds a job to the queue, waiting while the queue is full
+     */
+    void pushJob(Job job);
+
+    /***
+     * Removes a job from the queue, waiting while the queue is empty.
+     * Returns false once all input has been consumed.
+     */
+    bool popJob(Job& job);
+
+    /***
+     * Analyzes jobs until the input is exhausted
+     */
+    void workerLoop(int threadIdx);
+
+    void writeResult(const Job& job, const std::string& bestMove, int score, int depth, uint64_t nodes);
+
+public:
+    BatchAnalyzer(BatchOptions options);
+
+    /***
+     * Converts an EPD or FEN line to a FEN string that Chessboard can load.
+     * EPD lines only contain the first 4 FEN fields followed by operations, so the move
+     * counters are filled in. outId is set to the line's "id" operation, or cleared if it has none.
+     */
+    static std::string lineToFEN(const std::string& line, std::string& outId);
+
+    /***
+     * Escapes a string and places it inside double quotes, for CSV or JSON output
+     */
+    static std::string quote(const std::string& s, bool json);
+
+    /***
+     * Analyzes every position in the input and writes the results
+     */
+    void run();
+};
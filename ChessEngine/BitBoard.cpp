@@ -2,6 +2,7 @@
 #include <intrin.h>
 
 #include "Bitboard.h"
+#include "Cuckoo.h"
 
 namespace Bitboards {
 
@@ -52,6 +53,22 @@ namespace Bitboards {
         
         // init move arrays for sliding pieces
         generateMagics();
+
+        // the squares between two aligned squares are where the rays cast from each of them towards the other overlap
+        for (int s1 = 0; s1 < NUM_SQUARES; s1++) {
+            for (int s2 = 0; s2 < NUM_SQUARES; s2++) {
+                Bitboard bb1 = oneAt((Square)s1);
+                Bitboard bb2 = oneAt((Square)s2);
+                if (s1 != s2 && (getRookMoveTable((Square)s1, 0) & bb2)) {
+                    BETWEEN[s1][s2] = getRookMoveTable((Square)s1, ROOK_MASKS[s1] & bb2) & getRookMoveTable((Square)s2, ROOK_MASKS[s2] & bb1);
+                }
+                else if (s1 != s2 && (getBishopMoveTable((Square)s1, 0) & bb2)) {
+                    BETWEEN[s1][s2] = getBishopMoveTable((Square)s1, BISHOP_MASKS[s1] & bb2) & getBishopMoveTable((Square)s2, BISHOP_MASKS[s2] & bb1);
+                }
+            }
+        }
+
+        Cuckoo::init();
     }
 
     Square popLSB(Bitboard& b) {
@@ -121,11 +138,6 @@ namespace Bitboards {
         0x0000000000000080
     };
 
-    const Bitboard WHITE_KINGSIDE  = 0x0000000000000060;
-    const Bitboard WHITE_QUEENSIDE = 0x000000000000000e;
-    const Bitboard BLACK_KINGSIDE  = 0x6000000000000000;
-    const Bitboard BLACK_QUEENSIDE = 0x0e00000000000000;
-
     Bitboard ROOK_MASKS[NUM_SQUARES];
     Bitboard BISHOP_MASKS[NUM_SQUARES];
     Bitboard KNIGHT_MOVES[NUM_SQUARES];
@@ -134,6 +146,8 @@ namespace Bitboards {
     Bitboard PAWN_ATTACKS_WHITE[NUM_SQUARES];
     Bitboard PAWN_ATTACKS_BLACK[NUM_SQUARES];
 
+    Bitboard BETWEEN[NUM_SQUARES][NUM_SQUARES];
+
     Magic ROOK_MAGICS[NUM_SQUARES];
     Magic BISHOP_MAGICS[NUM_SQUARES];
     Bitboard ROOK_MOVES[NUM_SQUARES][MAX_ROOK_ATTACK_SETS];
@@ -69,6 +69,40 @@ namespace Bitboards {
      */
     inline bool contains(Bitboard b, Square s) { return b & oneAt(s); }
 
+    constexpr Bitboard FILE_A_BB = 0x0101010101010101;
+    constexpr Bitboard FILE_H_BB = FILE_A_BB << 7;
+    constexpr Bitboard RANK_1_BB = 0xff;
+    constexpr Bitboard RANK_2_BB = RANK_1_BB << 8;
+    constexpr Bitboard RANK_3_BB = RANK_1_BB << 16;
+    constexpr Bitboard RANK_6_BB = RANK_1_BB << 40;
+    constexpr Bitboard RANK_7_BB = RANK_1_BB << 48;
+
+    /*
+     * Square index offsets of one step in each direction
+     */
+    enum Direction : int {
+        NORTH = 8,
+        SOUTH = -8,
+        NORTH_EAST = 9,
+        NORTH_WEST = 7,
+        SOUTH_EAST = -7,
+        SOUTH_WEST = -9
+    };
+
+    /***
+     * Moves every square of a bitboard one step in a direction. Squares that would leave
+     * the board (including wrapping around to the other side) are dropped.
+     */
+    template <Direction D>
+    constexpr Bitboard shift(Bitboard b) {
+        if constexpr (D == NORTH) return b << 8;
+        else if constexpr (D == SOUTH) return b >> 8;
+        else if constexpr (D == NORTH_EAST) return (b & ~FILE_H_BB) << 9;
+        else if constexpr (D == NORTH_WEST) return (b & ~FILE_A_BB) << 7;
+        else if constexpr (D == SOUTH_EAST) return (b & ~FILE_H_BB) >> 7;
+        else return (b & ~FILE_A_BB) >> 9;
+    }
+
     /***
      * Pops the least significant bit from a given bitboard.
      * Returns the square that the popped bit was found at.
@@ -122,10 +156,19 @@ namespace Bitboards {
      * Masks to check if any pieces are between the king and rook
      * Used to see if there is a clear path for castling
      */
-    extern const Bitboard WHITE_KINGSIDE;
-    extern const Bitboard WHITE_QUEENSIDE;
-    extern const Bitboard BLACK_KINGSIDE;
-    extern const Bitboard BLACK_QUEENSIDE;
+    constexpr Bitboard WHITE_KINGSIDE  = 0x0000000000000060;
+    constexpr Bitboard WHITE_QUEENSIDE = 0x000000000000000e;
+    constexpr Bitboard BLACK_KINGSIDE  = 0x6000000000000000;
+    constexpr Bitboard BLACK_QUEENSIDE = 0x0e00000000000000;
+
+    /*
+     * Squares the king crosses or lands on when castling, none of which may be attacked.
+     * On the kingside they're the same squares that have to be empty.
+     */
+    constexpr Bitboard WHITE_KINGSIDE_PATH  = WHITE_KINGSIDE;
+    constexpr Bitboard WHITE_QUEENSIDE_PATH = 0x000000000000000c;
+    constexpr Bitboard BLACK_KINGSIDE_PATH  = BLACK_KINGSIDE;
+    constexpr Bitboard BLACK_QUEENSIDE_PATH = 0x0c00000000000000;
 
     extern Bitboard ROOK_MASKS[NUM_SQUARES];
     extern Bitboard BISHOP_MASKS[NUM_SQUARES];
@@ -136,6 +179,12 @@ namespace Bitboards {
     extern Bitboard PAWN_ATTACKS_WHITE[NUM_SQUARES];
     extern Bitboard PAWN_ATTACKS_BLACK[NUM_SQUARES];
 
+    /*
+     * Squares strictly between two squares that share a rank, file or diagonal, ex: BETWEEN[A1][D4] = B2 | C3
+     * Empty if the squares aren't aligned.
+     */
+    extern Bitboard BETWEEN[NUM_SQUARES][NUM_SQUARES];
+
     struct Magic {
         Bitboard magic;
         int shift;
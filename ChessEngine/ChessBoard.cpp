@@ -1,7 +1,10 @@
 
+#include <algorithm>
 #include <sstream>
 
 #include "Chessboard.h"
+#include "Cuckoo.h"
+#include "TranspositionTable.h"
 
 namespace Moves {
     std::string toString(Move& m) {
@@ -12,6 +15,40 @@ namespace Moves {
         }
         return out;
     }
+
+    bool fromString(const std::string& s, Move& outMove) {
+        if (s.size() != 4 && s.size() != 5) {
+            return false;
+        }
+        for (int i = 0; i < 4; i += 2) {
+            if (s[i] < 'a' || s[i] > 'h' || s[i + 1] < '1' || s[i + 1] > '8') {
+                return false;
+            }
+        }
+        outMove.from = Squares::fromRankFile(s[1] - '1', s[0] - 'a');
+        outMove.to = Squares::fromRankFile(s[3] - '1', s[2] - 'a');
+        outMove.promotion = Piece::PIECE_NONE;
+        outMove.isCapture = false;
+        if (s.size() == 5) {
+            switch (s[4]) {
+            case 'n':
+                outMove.promotion = Piece::KNIGHT;
+                break;
+            case 'b':
+                outMove.promotion = Piece::BISHOP;
+                break;
+            case 'r':
+                outMove.promotion = Piece::ROOK;
+                break;
+            case 'q':
+                outMove.promotion = Piece::QUEEN;
+                break;
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
 }
 
 Chessboard::Chessboard(std::string fen) {
@@ -32,40 +69,40 @@ Chessboard::Chessboard(std::string fen) {
     while (fen.at(idx) != ' ') {
         switch (fen.at(idx)) {
         case 'p':
-            pieces[Player::BLACK + Piece::PAWN] |= Bitboards::oneAt(square);
+            st->pieces[Player::BLACK + Piece::PAWN] |= Bitboards::oneAt(square);
             break;
         case 'P':
-            pieces[Player::WHITE + Piece::PAWN] |= Bitboards::oneAt(square);
+            st->pieces[Player::WHITE + Piece::PAWN] |= Bitboards::oneAt(square);
             break;
         case 'n':
-            pieces[Player::BLACK + Piece::KNIGHT] |= Bitboards::oneAt(square);
+            st->pieces[Player::BLACK + Piece::KNIGHT] |= Bitboards::oneAt(square);
             break;
         case 'N':
-            pieces[Player::WHITE + Piece::KNIGHT] |= Bitboards::oneAt(square);
+            st->pieces[Player::WHITE + Piece::KNIGHT] |= Bitboards::oneAt(square);
             break;
         case 'b':
-            pieces[Player::BLACK + Piece::BISHOP] |= Bitboards::oneAt(square);
+            st->pieces[Player::BLACK + Piece::BISHOP] |= Bitboards::oneAt(square);
             break;
         case 'B':
-            pieces[Player::WHITE + Piece::BISHOP] |= Bitboards::oneAt(square);
+            st->pieces[Player::WHITE + Piece::BISHOP] |= Bitboards::oneAt(square);
             break;
         case 'r':
-            pieces[Player::BLACK + Piece::ROOK] |= Bitboards::oneAt(square);
+            st->pieces[Player::BLACK + Piece::ROOK] |= Bitboards::oneAt(square);
             break;
         case 'R':
-            pieces[Player::WHITE + Piece::ROOK] |= Bitboards::oneAt(square);
+            st->pieces[Player::WHITE + Piece::ROOK] |= Bitboards::oneAt(square);
             break;
         case 'q':
-            pieces[Player::BLACK + Piece::QUEEN] |= Bitboards::oneAt(square);
+            st->pieces[Player::BLACK + Piece::QUEEN] |= Bitboards::oneAt(square);
             break;
         case 'Q':
-            pieces[Player::WHITE + Piece::QUEEN] |= Bitboards::oneAt(square);
+            st->pieces[Player::WHITE + Piece::QUEEN] |= Bitboards::oneAt(square);
             break;
         case 'k':
-            pieces[Player::BLACK + Piece::KING] |= Bitboards::oneAt(square);
+            st->pieces[Player::BLACK + Piece::KING] |= Bitboards::oneAt(square);
             break;
         case 'K':
-            pieces[Player::WHITE + Piece::KING] |= Bitboards::oneAt(square);
+            st->pieces[Player::WHITE + Piece::KING] |= Bitboards::oneAt(square);
             break;
         case '/':
             /*
@@ -92,7 +129,7 @@ Chessboard::Chessboard(std::string fen) {
 
     idx++; // skip space
     // Load current turn
-    currentTurn = fen.at(idx) == 'w' ? Player::WHITE : Player::BLACK;
+    st->currentTurn = fen.at(idx) == 'w' ? Player::WHITE : Player::BLACK;
 
     idx += 2; // skip turn and space
     // Load castling ability
@@ -100,16 +137,16 @@ Chessboard::Chessboard(std::string fen) {
         while (fen.at(idx) != ' ') {
             switch (fen.at(idx)) {
             case 'q':
-                castleAbility.bQueenside = true;
+                st->castleAbility.bQueenside = true;
                 break;
             case 'Q':
-                castleAbility.wQueenside = true;
+                st->castleAbility.wQueenside = true;
                 break;
             case 'k':
-                castleAbility.bKingside = true;
+                st->castleAbility.bKingside = true;
                 break;
             case 'K':
-                castleAbility.wKingside = true;
+                st->castleAbility.wKingside = true;
                 break;
             }
             idx++;
@@ -122,253 +159,641 @@ Chessboard::Chessboard(std::string fen) {
     idx++; // skip space
     // Load en passant target square
     if (fen.at(idx) != '-') {
-        enPassantTarget = Squares::fromAlgebraic(fen.substr(idx, 2).c_str());
+        st->enPassantTarget = Squares::fromAlgebraic(fen.substr(idx, 2).c_str());
         idx += 3; // skip past coordinate and space
     }
     else {
-        enPassantTarget = Square::SQUARE_NONE;
+        st->enPassantTarget = Square::SQUARE_NONE;
         idx += 2; // skip past '- '
     }
 
     // Load half move clock and full move number
     std::string halfMoveClockAndNumMoves = fen.substr(idx);
     size_t spaceIdx = halfMoveClockAndNumMoves.find(' ');
-    halfMoveClock = std::stoi(halfMoveClockAndNumMoves.substr(0, spaceIdx));
-    fullMoveNumber = std::stoi(halfMoveClockAndNumMoves.substr(spaceIdx));
+    st->halfMoveClock = std::stoi(halfMoveClockAndNumMoves.substr(0, spaceIdx));
+    st->fullMoveNumber = std::stoi(halfMoveClockAndNumMoves.substr(spaceIdx));
+
+    st->hash = computeHash();
+    updateStateInfo();
+}
+
+Chessboard::Chessboard(const PackedPosition& packed) {
+    // pieces are listed in order of increasing square index, so pop occupied squares from the LSB
+    Bitboard occupancy = packed.occupancy;
+    int pieceIdx = 0;
+    while (occupancy && pieceIdx < 32) {
+        Square sq = Bitboards::popLSB(occupancy);
+        st->pieces[PackedPositions::getNibble(packed, pieceIdx)] |= Bitboards::oneAt(sq);
+        pieceIdx++;
+    }
+
+    st->currentTurn = (packed.flags & PackedPositions::FLAG_BLACK_TO_MOVE) ? Player::BLACK : Player::WHITE;
+    st->castleAbility.wKingside = packed.flags & PackedPositions::FLAG_WHITE_KINGSIDE;
+    st->castleAbility.wQueenside = packed.flags & PackedPositions::FLAG_WHITE_QUEENSIDE;
+    st->castleAbility.bKingside = packed.flags & PackedPositions::FLAG_BLACK_KINGSIDE;
+    st->castleAbility.bQueenside = packed.flags & PackedPositions::FLAG_BLACK_QUEENSIDE;
+    st->enPassantTarget = packed.enPassant >= PackedPositions::NO_EN_PASSANT ? Square::SQUARE_NONE : (Square)packed.enPassant;
+    st->halfMoveClock = packed.halfMoveClock;
+    st->fullMoveNumber = packed.fullMoveNumber;
+
+    st->hash = computeHash();
+    updateStateInfo();
+}
+
+uint64_t Chessboard::computeHash() {
+    uint64_t h = 0;
+    for (int boardIdx = 0; boardIdx < 12; boardIdx++) {
+        Bitboard bb = st->pieces[boardIdx];
+        while (bb) {
+            h ^= Zobrist::KEYS.pieceSquare[boardIdx][Bitboards::popLSB(bb)];
+        }
+    }
+    h ^= castleHash(st->castleAbility);
+    if (st->enPassantTarget != Square::SQUARE_NONE) {
+        h ^= Zobrist::KEYS.enPassantFile[Squares::getFile(st->enPassantTarget)];
+    }
+    if (st->currentTurn == Player::BLACK) {
+        h ^= Zobrist::KEYS.blackToMove;
+    }
+    return h;
+}
+
+uint64_t Chessboard::castleHash(CastleAbility c) {
+    return (c.wKingside ? Zobrist::KEYS.castle[0] : 0) ^ (c.wQueenside ? Zobrist::KEYS.castle[1] : 0) ^
+        (c.bKingside ? Zobrist::KEYS.castle[2] : 0) ^ (c.bQueenside ? Zobrist::KEYS.castle[3] : 0);
+}
+
+PackedPosition Chessboard::toPacked() {
+    PackedPosition packed = { };
+    packed.occupancy = getAllPieces();
+
+    Bitboard occupancy = packed.occupancy;
+    int pieceIdx = 0;
+    while (occupancy && pieceIdx < 32) {
+        Bitboard sqBB = Bitboards::oneAt(Bitboards::popLSB(occupancy));
+        uint8_t boardIdx = 0;
+        while ((st->pieces[boardIdx] & sqBB) == 0) {
+            boardIdx++;
+        }
+        PackedPositions::setNibble(packed, pieceIdx, boardIdx);
+        pieceIdx++;
+    }
+
+    packed.flags = (st->currentTurn == Player::BLACK ? PackedPositions::FLAG_BLACK_TO_MOVE : 0) |
+        (st->castleAbility.wKingside ? PackedPositions::FLAG_WHITE_KINGSIDE : 0) |
+        (st->castleAbility.wQueenside ? PackedPositions::FLAG_WHITE_QUEENSIDE : 0) |
+        (st->castleAbility.bKingside ? PackedPositions::FLAG_BLACK_KINGSIDE : 0) |
+        (st->castleAbility.bQueenside ? PackedPositions::FLAG_BLACK_QUEENSIDE : 0);
+    packed.enPassant = st->enPassantTarget == Square::SQUARE_NONE ? PackedPositions::NO_EN_PASSANT : (uint8_t)st->enPassantTarget;
+    packed.halfMoveClock = st->halfMoveClock > 255 ? 255 : (uint8_t)st->halfMoveClock;
+    packed.fullMoveNumber = (uint16_t)st->fullMoveNumber;
+    return packed;
 }
 
 Player Chessboard::getTurn() {
-    return currentTurn;
+    return st->currentTurn;
 }
 
 int Chessboard::countPieces(Player player, Piece piece) {
-    return __popcnt64(pieces[player + piece]);
+    return __popcnt64(st->pieces[player + piece]);
 }
 
 Bitboard Chessboard::getAllPiecesByColor(Player color) {
     Bitboard out = 0;
     for (int p = Piece::PAWN; p <= Piece::KING; p++) {
-        out |= pieces[color + p];
+        out |= st->pieces[color + p];
     }
     return out;
 }
 
 std::vector<Move> Chessboard::generateAllLegalMoves() {
-    std::vector<Move> psuedolegalMoves = generateAllPseudolegalMoves();
-    std::vector<Move> legalMoves;
-    for (Move& m : psuedolegalMoves) {
+    // in check, only evasions can be legal
+    std::vector<Move> moves = generatePseudolegalMoves(st->info.checkers ? GEN_EVASIONS : GEN_ALL);
+    moves.erase(std::remove_if(moves.begin(), moves.end(), [this](Move& m) { return !isLegal(m); }), moves.end());
+    return moves;
+}
+
+bool Chessboard::isLegal(Move m) {
+    Bitboard fromBB = Bitboards::oneAt(m.from);
+    Bitboard toBB = Bitboards::oneAt(m.to);
+    Player us = st->currentTurn;
+    if (st->pieces[us + Piece::KING] & fromBB) {
+        // castling moves were only generated if the squares the king crosses are safe
+        return (getEnemyAttacks() & toBB) == 0;
+    }
+    if ((st->pieces[us + Piece::PAWN] & fromBB) && m.to == st->enPassantTarget) {
+        // en passant removes two pieces from a line at once, which the pins don't cover, so play it out
         MoveUndoInfo moveInfo = makeMove(m);
-        if (!isChecked(Players::getEnemy(currentTurn))) {
-            // if our move didn't result in the next player being able to attack the king, the move is legal
-            legalMoves.push_back(m);
-        }
+        bool legal = !isChecked(us);
         undoMove(moveInfo);
+        return legal;
     }
-    return legalMoves;
+
+    unsigned long kingSq = 0;
+    _BitScanForward64(&kingSq, st->pieces[us + Piece::KING]);
+    Bitboard checkers = st->info.checkers;
+    if (checkers) {
+        // against two checkers only the king can move. Against one, the move has to capture it or block
+        if (checkers & (checkers - 1)) {
+            return false;
+        }
+        unsigned long checkerSq = 0;
+        _BitScanForward64(&checkerSq, checkers);
+        if (((checkers | Bitboards::BETWEEN[kingSq][checkerSq]) & toBB) == 0) {
+            return false;
+        }
+    }
+    // a pinned piece can only move along the line through the king, either towards it or towards the pinner
+    return (st->info.pinned & fromBB) == 0 ||
+        (Bitboards::BETWEEN[kingSq][m.to] & fromBB) != 0 ||
+        (Bitboards::BETWEEN[kingSq][m.from] & toBB) != 0;
 }
 
-std::vector<Move> Chessboard::generateAllPseudolegalMoves() {
+std::vector<Move> Chessboard::generatePseudolegalMoves(GenType type) {
     std::vector<Move> moves;
+    moves.reserve(64);
+    bool white = st->currentTurn == Player::WHITE;
+    switch (type) {
+    case GEN_ALL:
+        white ? generateMoves<Player::WHITE, GEN_ALL>(moves) : generateMoves<Player::BLACK, GEN_ALL>(moves);
+        break;
+    case GEN_CAPTURES:
+        white ? generateMoves<Player::WHITE, GEN_CAPTURES>(moves) : generateMoves<Player::BLACK, GEN_CAPTURES>(moves);
+        break;
+    case GEN_QUIETS:
+        white ? generateMoves<Player::WHITE, GEN_QUIETS>(moves) : generateMoves<Player::BLACK, GEN_QUIETS>(moves);
+        break;
+    case GEN_EVASIONS:
+        white ? generateMoves<Player::WHITE, GEN_EVASIONS>(moves) : generateMoves<Player::BLACK, GEN_EVASIONS>(moves);
+        break;
+    }
+    return moves;
+}
 
-    generateKnightMoves(moves);
-    generateKingMoves(moves);
-    generateBishopMoves(moves);
-    generateRookMoves(moves);
-    generateQueenMoves(moves);
-
-    /* After generating all moves, update isCapture property.
-       This could've been done within each generate method,
-       but would cause duplicate code. 
-       
-       Note: it is very easy to tell if a pawn move is a capture, 
-             so generatePawnMoves handles that for us. 
-       */
-    Bitboard enemyPieces = getAllPiecesByColor(Players::getEnemy(currentTurn));
-    for (Move& m : moves) {
-        Bitboard target = Bitboards::oneAt(m.to);
-        if (enemyPieces & target) {
-            m.isCapture = true;
+template <Player Us, GenType Type>
+void Chessboard::generateMoves(std::vector<Move>& moves) {
+    constexpr Player Them = Us == Player::WHITE ? Player::BLACK : Player::WHITE;
+
+    Bitboard targets;
+    if constexpr (Type == GEN_ALL) {
+        targets = ~getAllPiecesByColor(Us);
+    }
+    else if constexpr (Type == GEN_CAPTURES) {
+        targets = getAllPiecesByColor(Them);
+    }
+    else if constexpr (Type == GEN_QUIETS) {
+        targets = ~getAllPieces();
+    }
+    else {
+        // against two checkers only the king can move. Against one, other pieces can capture it or block
+        unsigned long kingSq = 0;
+        _BitScanForward64(&kingSq, st->pieces[Us + Piece::KING]);
+        Bitboard checkers = st->info.checkers;
+        generateKingMoves<Us, Type>(moves);
+        if (checkers == 0 || (checkers & (checkers - 1)) != 0) {
+            return;
         }
+        unsigned long checkerSq = 0;
+        _BitScanForward64(&checkerSq, checkers);
+        targets = checkers | Bitboards::BETWEEN[kingSq][checkerSq];
     }
 
-    generatePawnMoves(moves);
-
-    return moves;
+    generatePieceMoves<Us, Piece::KNIGHT>(moves, targets);
+    if constexpr (Type != GEN_EVASIONS) {
+        generateKingMoves<Us, Type>(moves);
+    }
+    generatePieceMoves<Us, Piece::BISHOP>(moves, targets);
+    generatePieceMoves<Us, Piece::ROOK>(moves, targets);
+    generatePieceMoves<Us, Piece::QUEEN>(moves, targets);
+    generatePawnMoves<Us, Type>(moves, targets);
 }
 
 bool Chessboard::isAttacking(Player player, Square sq) {
     Bitboard allPieces = getAllPieces();
     // check pawn attacks
     Bitboard* pawnAttacks = player == Player::WHITE ? Bitboards::PAWN_ATTACKS_BLACK : Bitboards::PAWN_ATTACKS_WHITE;
-    if (pawnAttacks[sq] & pieces[player + Piece::PAWN]) {
+    if (pawnAttacks[sq] & st->pieces[player + Piece::PAWN]) {
         return true;
     }
-    if (Bitboards::KNIGHT_MOVES[sq] & pieces[player + Piece::KNIGHT]) {
+    if (Bitboards::KNIGHT_MOVES[sq] & st->pieces[player + Piece::KNIGHT]) {
         return true;
     }
     if (Bitboards::getBishopMoveTable(sq, Bitboards::BISHOP_MASKS[sq] & allPieces) & 
-        (pieces[player + Piece::BISHOP] | pieces[player + Piece::QUEEN])) {
+        (st->pieces[player + Piece::BISHOP] | st->pieces[player + Piece::QUEEN])) {
         return true;
     }
     if (Bitboards::getRookMoveTable(sq, Bitboards::ROOK_MASKS[sq] & allPieces) &
-        (pieces[player + Piece::ROOK] | pieces[player + Piece::QUEEN])) {
+        (st->pieces[player + Piece::ROOK] | st->pieces[player + Piece::QUEEN])) {
         return true;
     }
-    if (Bitboards::KING_MOVES[sq] & pieces[player + Piece::KING]) {
+    if (Bitboards::KING_MOVES[sq] & st->pieces[player + Piece::KING]) {
         return true;
     }
     return false;
 }
 
 bool Chessboard::isChecked(Player p) {
+    if (p == st->currentTurn) {
+        return st->info.checkers != 0;
+    }
     unsigned long kingLoc;
-    _BitScanForward64(&kingLoc, pieces[p + Piece::KING]);
+    _BitScanForward64(&kingLoc, st->pieces[p + Piece::KING]);
     return isAttacking(Players::getEnemy(p), (Square)kingLoc);
 }
 
-void Chessboard::generatePawnMoves(std::vector<Move>& moves) {
-    Bitboard pawns = pieces[Piece::PAWN + currentTurn];
+Bitboard Chessboard::getAttackers(Player player, Square sq) {
     Bitboard allPieces = getAllPieces();
-    // imagine an enemy piece is at en passant target
-    Bitboard enemyPieces = getAllPiecesByColor(Players::getEnemy(currentTurn)) | Bitboards::oneAt(enPassantTarget);
-    Rank promoteRank = currentTurn == Player::WHITE ? RANK_8 : RANK_1;
-    Rank startingRank = currentTurn == Player::WHITE ? RANK_2 : RANK_7;
-    while (pawns) {
-        Square from = Bitboards::popLSB(pawns);
-        Bitboard movesBoard = currentTurn == Player::WHITE ? Bitboards::oneAt((Square)(from + 8)) : Bitboards::oneAt((Square)(from - 8));
-        movesBoard = movesBoard & ~allPieces;
-        Bitboard attacksBoard = currentTurn == Player::WHITE ? Bitboards::PAWN_ATTACKS_WHITE[from] : Bitboards::PAWN_ATTACKS_BLACK[from];
-        attacksBoard = attacksBoard & enemyPieces;
-        while (movesBoard) {
-            Square to = Bitboards::popLSB(movesBoard);
-            if (Squares::getRank(to) == promoteRank) {
-                moves.push_back({ from, to, Piece::KNIGHT });
-                moves.push_back({ from, to, Piece::BISHOP });
-                moves.push_back({ from, to, Piece::ROOK });
-                moves.push_back({ from, to, Piece::QUEEN });
-            }
-            else {
-                moves.push_back({ from, to });
-            }
+    Bitboard* pawnAttacks = player == Player::WHITE ? Bitboards::PAWN_ATTACKS_BLACK : Bitboards::PAWN_ATTACKS_WHITE;
+    Bitboard diagonal = st->pieces[player + Piece::BISHOP] | st->pieces[player + Piece::QUEEN];
+    Bitboard straight = st->pieces[player + Piece::ROOK] | st->pieces[player + Piece::QUEEN];
+    return (pawnAttacks[sq] & st->pieces[player + Piece::PAWN]) |
+        (Bitboards::KNIGHT_MOVES[sq] & st->pieces[player + Piece::KNIGHT]) |
+        (Bitboards::getBishopMoveTable(sq, Bitboards::BISHOP_MASKS[sq] & allPieces) & diagonal) |
+        (Bitboards::getRookMoveTable(sq, Bitboards::ROOK_MASKS[sq] & allPieces) & straight) |
+        (Bitboards::KING_MOVES[sq] & st->pieces[player + Piece::KING]);
+}
 
-            // double push
-            Square doublePushSquare = (Square)(currentTurn == Player::WHITE ? to + 8 : to - 8);
-            Bitboard doublePush = Bitboards::oneAt(doublePushSquare);
-            if (Squares::getRank(from) == startingRank && (doublePush & allPieces) == 0) {
-                moves.push_back({ from, doublePushSquare });
-            }
+Bitboard Chessboard::getAllAttackers(Square sq, Bitboard occupied) {
+    Bitboard diagonal = st->pieces[Player::WHITE + Piece::BISHOP] | st->pieces[Player::WHITE + Piece::QUEEN] |
+        st->pieces[Player::BLACK + Piece::BISHOP] | st->pieces[Player::BLACK + Piece::QUEEN];
+    Bitboard straight = st->pieces[Player::WHITE + Piece::ROOK] | st->pieces[Player::WHITE + Piece::QUEEN] |
+        st->pieces[Player::BLACK + Piece::ROOK] | st->pieces[Player::BLACK + Piece::QUEEN];
+    return (Bitboards::PAWN_ATTACKS_BLACK[sq] & st->pieces[Player::WHITE + Piece::PAWN]) |
+        (Bitboards::PAWN_ATTACKS_WHITE[sq] & st->pieces[Player::BLACK + Piece::PAWN]) |
+        (Bitboards::KNIGHT_MOVES[sq] & (st->pieces[Player::WHITE + Piece::KNIGHT] | st->pieces[Player::BLACK + Piece::KNIGHT])) |
+        (Bitboards::getBishopMoveTable(sq, Bitboards::BISHOP_MASKS[sq] & occupied) & diagonal) |
+        (Bitboards::getRookMoveTable(sq, Bitboards::ROOK_MASKS[sq] & occupied) & straight) |
+        (Bitboards::KING_MOVES[sq] & (st->pieces[Player::WHITE + Piece::KING] | st->pieces[Player::BLACK + Piece::KING]));
+}
+
+int Chessboard::see(Move m) {
+    Player side = st->currentTurn;
+    Piece onSquare = getPieceTypeAtSquareGivenColor(m.from, side);
+    Piece capturer = onSquare;
+    Piece captured = getPieceTypeAtSquareGivenColor(m.to, Players::getEnemy(side));
+    Bitboard whitePieces = getAllPiecesByColor(Player::WHITE);
+    Bitboard blackPieces = getAllPiecesByColor(Player::BLACK);
+    Bitboard occupied = whitePieces | blackPieces;
+    if (onSquare == Piece::PAWN && m.to == st->enPassantTarget) {
+        // the captured pawn is behind the target square, where it may block a slider
+        captured = Piece::PAWN;
+        occupied ^= Bitboards::oneAt((Square)(side == Player::WHITE ? m.to - 8 : m.to + 8));
+    }
+
+    // gain[d] is the material of the side making the d-th capture if the exchange stopped after it
+    int gain[32];
+    int d = 0;
+    gain[0] = captured == Piece::PIECE_NONE ? 0 : SEE_VALUES[captured];
+    if (m.promotion != Piece::PIECE_NONE) {
+        gain[0] += SEE_VALUES[m.promotion] - SEE_VALUES[Piece::PAWN];
+        onSquare = m.promotion;
+    }
+
+    Bitboard diagonal = st->pieces[Player::WHITE + Piece::BISHOP] | st->pieces[Player::WHITE + Piece::QUEEN] |
+        st->pieces[Player::BLACK + Piece::BISHOP] | st->pieces[Player::BLACK + Piece::QUEEN];
+    Bitboard straight = st->pieces[Player::WHITE + Piece::ROOK] | st->pieces[Player::WHITE + Piece::QUEEN] |
+        st->pieces[Player::BLACK + Piece::ROOK] | st->pieces[Player::BLACK + Piece::QUEEN];
+    Bitboard attackers = getAllAttackers(m.to, occupied);
+    Bitboard fromSet = Bitboards::oneAt(m.from);
+    while (d < 31) {
+        d++;
+        gain[d] = SEE_VALUES[onSquare] - gain[d - 1];
+
+        // the capturer leaves its square, which uncovers any slider behind it. A pawn or king can
+        // stand on either kind of line (a pawn push is straight), a knight on neither
+        occupied ^= fromSet;
+        if (capturer != Piece::KNIGHT && capturer != Piece::ROOK) {
+            attackers |= Bitboards::getBishopMoveTable(m.to, Bitboards::BISHOP_MASKS[m.to] & occupied) & diagonal;
         }
-        while (attacksBoard) {
-            Square to = Bitboards::popLSB(attacksBoard);
-            if (Squares::getRank(to) == promoteRank) {
-                moves.push_back({ from, to, Piece::KNIGHT, true /* isCapture */});
-                moves.push_back({ from, to, Piece::BISHOP, true });
-                moves.push_back({ from, to, Piece::ROOK, true });
-                moves.push_back({ from, to, Piece::QUEEN, true });
+        if (capturer != Piece::KNIGHT && capturer != Piece::BISHOP) {
+            attackers |= Bitboards::getRookMoveTable(m.to, Bitboards::ROOK_MASKS[m.to] & occupied) & straight;
+        }
+        attackers &= occupied;
+
+        // the other side recaptures with its least valuable attacker
+        side = Players::getEnemy(side);
+        Bitboard sideAttackers = attackers & (side == Player::WHITE ? whitePieces : blackPieces);
+        if (sideAttackers == 0) {
+            break;
+        }
+        capturer = Piece::PAWN;
+        while ((sideAttackers & st->pieces[side + capturer]) == 0) {
+            capturer = (Piece)(capturer + 1);
+        }
+        if (capturer == Piece::KING && (attackers & ~sideAttackers)) {
+            break; // the king can't capture onto a defended square
+        }
+        Bitboard pieces = st->pieces[side + capturer] & sideAttackers;
+        fromSet = pieces & (~pieces + 1);
+        onSquare = capturer;
+    }
+
+    // the last gain assumed one more capture that didn't happen. Going back, each side only captures if it gains
+    while (--d) {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    }
+    return gain[0];
+}
+
+void Chessboard::updateStateInfo() {
+    Player us = st->currentTurn;
+    Player them = Players::getEnemy(us);
+    Bitboard king = st->pieces[us + Piece::KING];
+    Bitboard allPieces = getAllPieces();
+    Bitboard diagonal = st->pieces[them + Piece::BISHOP] | st->pieces[them + Piece::QUEEN];
+    Bitboard straight = st->pieces[them + Piece::ROOK] | st->pieces[them + Piece::QUEEN];
+
+    st->info.checkers = 0;
+    st->info.pinned = 0;
+    if (king) {
+        unsigned long kingSq = 0;
+        _BitScanForward64(&kingSq, king);
+        Bitboard* pawnAttacks = us == Player::WHITE ? Bitboards::PAWN_ATTACKS_WHITE : Bitboards::PAWN_ATTACKS_BLACK;
+        st->info.checkers = (pawnAttacks[kingSq] & st->pieces[them + Piece::PAWN]) |
+            (Bitboards::KNIGHT_MOVES[kingSq] & st->pieces[them + Piece::KNIGHT]);
+
+        // a slider that would attack the king on an empty board checks it if nothing is between them,
+        // and pins the piece between them if there's only one
+        Bitboard snipers = (Bitboards::getBishopMoveTable((Square)kingSq, 0) & diagonal) |
+            (Bitboards::getRookMoveTable((Square)kingSq, 0) & straight);
+        while (snipers) {
+            Square sniperSq = Bitboards::popLSB(snipers);
+            Bitboard between = Bitboards::BETWEEN[kingSq][sniperSq] & allPieces;
+            if (between == 0) {
+                st->info.checkers |= Bitboards::oneAt(sniperSq);
             }
-            else {
-                moves.push_back({ from, to, Piece::PIECE_NONE, true});
+            else if ((between & (between - 1)) == 0) {
+                st->info.pinned |= between & getAllPiecesByColor(us);
             }
         }
     }
+
+    st->info.enemyAttacksValid = false;
+    st->info.checkInfoValid = false;
 }
 
-void Chessboard::generateKnightMoves(std::vector<Move>& moves) {
-    Bitboard knights = pieces[Piece::KNIGHT + currentTurn];
-    Bitboard maskFriendlyPieces = ~getAllPiecesByColor(currentTurn);
-    while (knights) {
-        Square from = Bitboards::popLSB(knights);
-        Bitboard movesBoard = Bitboards::KNIGHT_MOVES[from] & maskFriendlyPieces;
-        while (movesBoard) {
-            Square to = Bitboards::popLSB(movesBoard);
-            moves.push_back({ from, to });
+void Chessboard::updateCheckInfo() {
+    Player us = st->currentTurn;
+    Player them = Players::getEnemy(us);
+    Bitboard enemyKing = st->pieces[them + Piece::KING];
+    st->info.diagonalCheckSquares = 0;
+    st->info.straightCheckSquares = 0;
+    st->info.discoveredCheckers = 0;
+    st->info.checkInfoValid = true;
+    if (enemyKing == 0) {
+        return;
+    }
+
+    unsigned long kingSq = 0;
+    _BitScanForward64(&kingSq, enemyKing);
+    Bitboard allPieces = getAllPieces();
+    st->info.diagonalCheckSquares = Bitboards::getBishopMoveTable((Square)kingSq, Bitboards::BISHOP_MASKS[kingSq] & allPieces);
+    st->info.straightCheckSquares = Bitboards::getRookMoveTable((Square)kingSq, Bitboards::ROOK_MASKS[kingSq] & allPieces);
+
+    // like pins, but with our sliders aimed at their king through one of our own pieces
+    Bitboard snipers = (Bitboards::getBishopMoveTable((Square)kingSq, 0) & (st->pieces[us + Piece::BISHOP] | st->pieces[us + Piece::QUEEN])) |
+        (Bitboards::getRookMoveTable((Square)kingSq, 0) & (st->pieces[us + Piece::ROOK] | st->pieces[us + Piece::QUEEN]));
+    Bitboard ownPieces = getAllPiecesByColor(us);
+    while (snipers) {
+        Bitboard between = Bitboards::BETWEEN[kingSq][Bitboards::popLSB(snipers)] & allPieces;
+        if (between && (between & (between - 1)) == 0) {
+            st->info.discoveredCheckers |= between & ownPieces;
         }
     }
 }
 
-void Chessboard::generateKingMoves(std::vector<Move>& moves) {
-    Bitboard king = pieces[Piece::KING + currentTurn];
-    Bitboard maskFriendlyPieces = ~getAllPiecesByColor(currentTurn);
-    Bitboard allPieces = getAllPieces();
-    Square from = Bitboards::popLSB(king);
-    Bitboard movesBoard = Bitboards::KING_MOVES[from] & maskFriendlyPieces;
-    
-   
-    Bitboard kingSideMask = currentTurn == Player::WHITE ? Bitboards::WHITE_KINGSIDE : Bitboards::BLACK_KINGSIDE;
-    Bitboard queenSideMask = currentTurn == Player::WHITE ? Bitboards::WHITE_QUEENSIDE : Bitboards::BLACK_QUEENSIDE;
+bool Chessboard::givesCheck(Move m) {
+    Player us = st->currentTurn;
+    Player them = Players::getEnemy(us);
+    Piece piece = getPieceTypeAtSquareGivenColor(m.from, us);
 
-    while (movesBoard) {
-        Square to = Bitboards::popLSB(movesBoard);
-        moves.push_back({ from, to });
+    // these move or remove a second piece, which the check info doesn't cover
+    bool isCastle = piece == Piece::KING && (m.to - m.from == 2 || m.from - m.to == 2);
+    bool isEnPassant = piece == Piece::PAWN && m.to == st->enPassantTarget;
+    if (isCastle || isEnPassant || m.promotion != Piece::PIECE_NONE) {
+        MoveUndoInfo moveInfo = makeMove(m);
+        bool check = st->info.checkers != 0;
+        undoMove(moveInfo);
+        return check;
     }
 
-    if (!isChecked(currentTurn)) {
-        if (currentTurn == Player::WHITE) {
-            if (castleAbility.wKingside && (allPieces & Bitboards::WHITE_KINGSIDE) == 0 && 
-                !isAttacking(Player::BLACK, Square::F1) && !isAttacking(Player::BLACK, Square::G1)) {
-                moves.push_back({ E1, G1 });
-            }
-            if (castleAbility.wQueenside && (allPieces & Bitboards::WHITE_QUEENSIDE) == 0 &&
-                !isAttacking(Player::BLACK, Square::D1) && !isAttacking(Player::BLACK, Square::C1)) {
-                moves.push_back({ E1, C1 });
-            }
+    Bitboard enemyKing = st->pieces[them + Piece::KING];
+    if (enemyKing == 0) {
+        return false;
+    }
+    if (!st->info.checkInfoValid) {
+        updateCheckInfo();
+    }
+
+    Bitboard toBB = Bitboards::oneAt(m.to);
+    switch (piece) {
+    case Piece::PAWN:
+        if ((us == Player::WHITE ? Bitboards::PAWN_ATTACKS_WHITE : Bitboards::PAWN_ATTACKS_BLACK)[m.to] & enemyKing) {
+            return true;
         }
-        else {
-            if (castleAbility.bKingside && (allPieces & Bitboards::BLACK_KINGSIDE) == 0 &&
-                !isAttacking(Player::WHITE, Square::F8) && !isAttacking(Player::WHITE, Square::G8)) {
-                moves.push_back({ E8, G8 });
-            }
-            if (castleAbility.bQueenside && (allPieces & Bitboards::BLACK_QUEENSIDE) == 0 &&
-                !isAttacking(Player::WHITE, Square::D8) && !isAttacking(Player::WHITE, Square::C8)) {
-                moves.push_back({ E8, C8 });
-            }
+        break;
+    case Piece::KNIGHT:
+        if (Bitboards::KNIGHT_MOVES[m.to] & enemyKing) {
+            return true;
+        }
+        break;
+    case Piece::BISHOP:
+        if (st->info.diagonalCheckSquares & toBB) {
+            return true;
+        }
+        break;
+    case Piece::ROOK:
+        if (st->info.straightCheckSquares & toBB) {
+            return true;
         }
+        break;
+    case Piece::QUEEN:
+        if ((st->info.diagonalCheckSquares | st->info.straightCheckSquares) & toBB) {
+            return true;
+        }
+        break;
+    default:
+        break;
     }
-    
+
+    // a discovered check, unless the piece stays on the line it was blocking
+    Bitboard fromBB = Bitboards::oneAt(m.from);
+    if (st->info.discoveredCheckers & fromBB) {
+        unsigned long kingSq = 0;
+        _BitScanForward64(&kingSq, enemyKing);
+        return (Bitboards::BETWEEN[kingSq][m.to] & fromBB) == 0 && (Bitboards::BETWEEN[kingSq][m.from] & toBB) == 0;
+    }
+    return false;
 }
 
-void Chessboard::generateBishopMoves(std::vector<Move>& moves) {
-    Bitboard bishops = pieces[Piece::BISHOP + currentTurn];
-    Bitboard maskFriendlyPieces = ~getAllPiecesByColor(currentTurn);
-    Bitboard allPieces = getAllPieces();
-    while (bishops) {
-        Square from = Bitboards::popLSB(bishops);
-        Bitboard movesBoard = Bitboards::getBishopMoveTable(from, Bitboards::BISHOP_MASKS[from] & allPieces);
-        movesBoard &= maskFriendlyPieces;
-        while (movesBoard) {
-            Square to = Bitboards::popLSB(movesBoard);
-            moves.push_back({ from, to });
+void Chessboard::updateEnemyAttacks() {
+    Player them = Players::getEnemy(st->currentTurn);
+    Bitboard diagonal = st->pieces[them + Piece::BISHOP] | st->pieces[them + Piece::QUEEN];
+    Bitboard straight = st->pieces[them + Piece::ROOK] | st->pieces[them + Piece::QUEEN];
+
+    // sliders see through the king, so squares behind it on a checking line count as attacked
+    Bitboard occupied = getAllPieces() & ~st->pieces[st->currentTurn + Piece::KING];
+    Bitboard pawns = st->pieces[them + Piece::PAWN];
+    Bitboard attacks = them == Player::WHITE ?
+        Bitboards::shift<Bitboards::NORTH_WEST>(pawns) | Bitboards::shift<Bitboards::NORTH_EAST>(pawns) :
+        Bitboards::shift<Bitboards::SOUTH_WEST>(pawns) | Bitboards::shift<Bitboards::SOUTH_EAST>(pawns);
+    Bitboard knights = st->pieces[them + Piece::KNIGHT];
+    while (knights) {
+        attacks |= Bitboards::KNIGHT_MOVES[Bitboards::popLSB(knights)];
+    }
+    while (diagonal) {
+        Square sq = Bitboards::popLSB(diagonal);
+        attacks |= Bitboards::getBishopMoveTable(sq, Bitboards::BISHOP_MASKS[sq] & occupied);
+    }
+    while (straight) {
+        Square sq = Bitboards::popLSB(straight);
+        attacks |= Bitboards::getRookMoveTable(sq, Bitboards::ROOK_MASKS[sq] & occupied);
+    }
+    Bitboard enemyKing = st->pieces[them + Piece::KING];
+    if (enemyKing) {
+        attacks |= Bitboards::KING_MOVES[Bitboards::popLSB(enemyKing)];
+    }
+    st->info.enemyAttacks = attacks;
+    st->info.enemyAttacksValid = true;
+}
+
+/***
+ * Adds a move for every square of a bitboard, coming from `offset` squares behind it
+ */
+static void addPawnMoves(std::vector<Move>& moves, Bitboard destinations, int offset, bool isCapture) {
+    while (destinations) {
+        Square to = Bitboards::popLSB(destinations);
+        moves.push_back({ (Square)(to - offset), to, Piece::PIECE_NONE, isCapture });
+    }
+}
+
+static void addPromotions(std::vector<Move>& moves, Bitboard destinations, int offset, bool isCapture) {
+    while (destinations) {
+        Square to = Bitboards::popLSB(destinations);
+        Square from = (Square)(to - offset);
+        moves.push_back({ from, to, Piece::KNIGHT, isCapture });
+        moves.push_back({ from, to, Piece::BISHOP, isCapture });
+        moves.push_back({ from, to, Piece::ROOK, isCapture });
+        moves.push_back({ from, to, Piece::QUEEN, isCapture });
+    }
+}
+
+template <Player Us, GenType Type>
+void Chessboard::generatePawnMoves(std::vector<Move>& moves, Bitboard targets) {
+    constexpr Player Them = Us == Player::WHITE ? Player::BLACK : Player::WHITE;
+    constexpr Bitboards::Direction Up = Us == Player::WHITE ? Bitboards::NORTH : Bitboards::SOUTH;
+    constexpr Bitboards::Direction UpEast = Us == Player::WHITE ? Bitboards::NORTH_EAST : Bitboards::SOUTH_EAST;
+    constexpr Bitboards::Direction UpWest = Us == Player::WHITE ? Bitboards::NORTH_WEST : Bitboards::SOUTH_WEST;
+    constexpr Bitboard PromotingRank = Us == Player::WHITE ? Bitboards::RANK_7_BB : Bitboards::RANK_2_BB;
+    constexpr Bitboard DoublePushRank = Us == Player::WHITE ? Bitboards::RANK_3_BB : Bitboards::RANK_6_BB; // after one push
+    Bitboard* pawnAttacksThem = Us == Player::WHITE ? Bitboards::PAWN_ATTACKS_BLACK : Bitboards::PAWN_ATTACKS_WHITE;
+
+    // pushes only need an empty square and captures an enemy piece, except when evading check
+    Bitboard pushTargets = ~getAllPieces() & (Type == GEN_EVASIONS ? targets : ~(Bitboard)0);
+    Bitboard captureTargets = getAllPiecesByColor(Them) & (Type == GEN_EVASIONS ? targets : ~(Bitboard)0);
+
+    // the whole set of pawns is shifted at once, each resulting bit is one move
+    Bitboard pawns = st->pieces[Us + Piece::PAWN];
+    Bitboard promoting = pawns & PromotingRank;
+    Bitboard others = pawns & ~PromotingRank;
+
+    if constexpr (Type != GEN_CAPTURES) {
+        Bitboard empty = ~getAllPieces();
+        Bitboard singlePushes = Bitboards::shift<Up>(others) & empty;
+        Bitboard doublePushes = Bitboards::shift<Up>(singlePushes & DoublePushRank) & empty;
+        addPawnMoves(moves, singlePushes & pushTargets, Up, false);
+        addPawnMoves(moves, doublePushes & pushTargets, 2 * Up, false);
+    }
+
+    if constexpr (Type != GEN_QUIETS) {
+        if (promoting) {
+            addPromotions(moves, Bitboards::shift<Up>(promoting) & pushTargets, Up, false);
+            addPromotions(moves, Bitboards::shift<UpWest>(promoting) & captureTargets, UpWest, true);
+            addPromotions(moves, Bitboards::shift<UpEast>(promoting) & captureTargets, UpEast, true);
+        }
+        addPawnMoves(moves, Bitboards::shift<UpWest>(others) & captureTargets, UpWest, true);
+        addPawnMoves(moves, Bitboards::shift<UpEast>(others) & captureTargets, UpEast, true);
+
+        if (st->enPassantTarget != Square::SQUARE_NONE) {
+            // pawns that could capture onto the target are the squares an enemy pawn there would attack
+            Bitboard capturers = others & pawnAttacksThem[st->enPassantTarget];
+            while (capturers) {
+                moves.push_back({ Bitboards::popLSB(capturers), st->enPassantTarget, Piece::PIECE_NONE, true });
+            }
         }
     }
 }
 
-void Chessboard::generateRookMoves(std::vector<Move>& moves) {
-    Bitboard rooks = pieces[Piece::ROOK + currentTurn];
-    Bitboard maskFriendlyPieces = ~getAllPiecesByColor(currentTurn);
+template <Player Us, Piece P>
+void Chessboard::generatePieceMoves(std::vector<Move>& moves, Bitboard targets) {
+    constexpr Player Them = Us == Player::WHITE ? Player::BLACK : Player::WHITE;
+    Bitboard pieces = st->pieces[Us + P];
     Bitboard allPieces = getAllPieces();
-    while (rooks) {
-        Square from = Bitboards::popLSB(rooks);
-        Bitboard movesBoard = Bitboards::getRookMoveTable(from, Bitboards::ROOK_MASKS[from] & allPieces);
-        movesBoard &= maskFriendlyPieces;
+    Bitboard enemyPieces = getAllPiecesByColor(Them);
+    while (pieces) {
+        Square from = Bitboards::popLSB(pieces);
+        Bitboard movesBoard;
+        if constexpr (P == Piece::KNIGHT) {
+            movesBoard = Bitboards::KNIGHT_MOVES[from];
+        }
+        else if constexpr (P == Piece::BISHOP) {
+            movesBoard = Bitboards::getBishopMoveTable(from, Bitboards::BISHOP_MASKS[from] & allPieces);
+        }
+        else if constexpr (P == Piece::ROOK) {
+            movesBoard = Bitboards::getRookMoveTable(from, Bitboards::ROOK_MASKS[from] & allPieces);
+        }
+        else {
+            movesBoard = Bitboards::getRookMoveTable(from, Bitboards::ROOK_MASKS[from] & allPieces) |
+                Bitboards::getBishopMoveTable(from, Bitboards::BISHOP_MASKS[from] & allPieces);
+        }
+        movesBoard &= targets;
         while (movesBoard) {
             Square to = Bitboards::popLSB(movesBoard);
-            moves.push_back({ from, to });
+            moves.push_back({ from, to, Piece::PIECE_NONE, Bitboards::contains(enemyPieces, to) });
         }
     }
 }
 
-void Chessboard::generateQueenMoves(std::vector<Move>& moves) {
-    Bitboard queens = pieces[Piece::QUEEN + currentTurn];
-    Bitboard maskFriendlyPieces = ~getAllPiecesByColor(currentTurn);
-    Bitboard allPieces = getAllPieces();
-    while (queens) {
-        Square from = Bitboards::popLSB(queens);
-        Bitboard movesBoard = Bitboards::getRookMoveTable(from, Bitboards::ROOK_MASKS[from] & allPieces);
-        movesBoard |= Bitboards::getBishopMoveTable(from, Bitboards::BISHOP_MASKS[from] & allPieces);;
-        movesBoard &= maskFriendlyPieces;
-        while (movesBoard) {
-            Square to = Bitboards::popLSB(movesBoard);
-            moves.push_back({ from, to });
+template <Player Us, GenType Type>
+void Chessboard::generateKingMoves(std::vector<Move>& moves) {
+    constexpr Player Them = Us == Player::WHITE ? Player::BLACK : Player::WHITE;
+    constexpr Square Start = Us == Player::WHITE ? Square::E1 : Square::E8;
+    constexpr Bitboard KingsideMask = Us == Player::WHITE ? Bitboards::WHITE_KINGSIDE : Bitboards::BLACK_KINGSIDE;
+    constexpr Bitboard QueensideMask = Us == Player::WHITE ? Bitboards::WHITE_QUEENSIDE : Bitboards::BLACK_QUEENSIDE;
+    constexpr Bitboard KingsidePath = Us == Player::WHITE ? Bitboards::WHITE_KINGSIDE_PATH : Bitboards::BLACK_KINGSIDE_PATH;
+    constexpr Bitboard QueensidePath = Us == Player::WHITE ? Bitboards::WHITE_QUEENSIDE_PATH : Bitboards::BLACK_QUEENSIDE_PATH;
+
+    Bitboard enemyPieces = getAllPiecesByColor(Them);
+    Bitboard targets;
+    if constexpr (Type == GEN_CAPTURES) {
+        targets = enemyPieces;
+    }
+    else if constexpr (Type == GEN_QUIETS) {
+        targets = ~getAllPieces();
+    }
+    else {
+        targets = ~getAllPiecesByColor(Us);
+    }
+
+    Bitboard king = st->pieces[Us + Piece::KING];
+    Square from = Bitboards::popLSB(king);
+    Bitboard movesBoard = Bitboards::KING_MOVES[from] & targets;
+    while (movesBoard) {
+        Square to = Bitboards::popLSB(movesBoard);
+        moves.push_back({ from, to, Piece::PIECE_NONE, Bitboards::contains(enemyPieces, to) });
+    }
+
+    if constexpr (Type == GEN_ALL || Type == GEN_QUIETS) {
+        bool kingside = Us == Player::WHITE ? st->castleAbility.wKingside : st->castleAbility.bKingside;
+        bool queenside = Us == Player::WHITE ? st->castleAbility.wQueenside : st->castleAbility.bQueenside;
+        if ((kingside || queenside) && st->info.checkers == 0) {
+            Bitboard allPieces = getAllPieces();
+            if (kingside && (allPieces & KingsideMask) == 0 && (getEnemyAttacks() & KingsidePath) == 0) {
+                moves.push_back({ Start, (Square)(Start + 2) });
+            }
+            if (queenside && (allPieces & QueensideMask) == 0 && (getEnemyAttacks() & QueensidePath) == 0) {
+                moves.push_back({ Start, (Square)(Start - 2) });
+            }
         }
     }
 }
@@ -376,90 +801,118 @@ void Chessboard::generateQueenMoves(std::vector<Move>& moves) {
 Piece Chessboard::getPieceTypeAtSquareGivenColor(Square s, Player player) {
     Piece piece = Piece::PAWN;
     Bitboard bb = Bitboards::oneAt(s);
-    while (piece != Piece::PIECE_NONE && (pieces[player + piece] & bb) == 0) {
+    while (piece != Piece::PIECE_NONE && (st->pieces[player + piece] & bb) == 0) {
         piece = (Piece)(piece + 1);
     }
     return piece;
 }
 
-MoveUndoInfo Chessboard::makeMove(Move m) {
+Chessboard::Chessboard(const Chessboard& other) : states(other.states) {
+    st = states.data() + (other.st - other.states.data());
+}
+
+Chessboard& Chessboard::operator=(const Chessboard& other) {
+    states = other.states;
+    st = states.data() + (other.st - other.states.data());
+    return *this;
+}
+
+MoveUndoInfo Chessboard::makeMove(Move m, const TranspositionTable* tt) {
+    if (st == &states.back()) {
+        size_t ply = st - states.data();
+        states.resize(states.size() * 2);
+        st = states.data() + ply;
+    }
+    st[1] = st[0];
+    st++;
+    return makeMoveInPlace(m, tt);
+}
+
+void Chessboard::undoMove(MoveUndoInfo) {
+    st--;
+}
+
+MoveUndoInfo Chessboard::makeMoveInPlace(Move m, const TranspositionTable* tt) {
     Bitboard fromBB = Bitboards::oneAt(m.from);
     Bitboard toBB = Bitboards::oneAt(m.to);
-    Piece fromPiece = getPieceTypeAtSquareGivenColor(m.from, currentTurn);
-    CastleAbility oldCastleAbility = castleAbility;
+    Piece fromPiece = getPieceTypeAtSquareGivenColor(m.from, st->currentTurn);
+    CastleAbility oldCastleAbility = st->castleAbility;
 
     // check if there is an enemy piece at destination
-    Piece toPiece = getPieceTypeAtSquareGivenColor(m.to, Players::getEnemy(currentTurn));
+    Piece toPiece = getPieceTypeAtSquareGivenColor(m.to, Players::getEnemy(st->currentTurn));
+    uint64_t oldHash = st->hash;
 
     // perform move
-    pieces[currentTurn + fromPiece] &= ~fromBB; // remove piece from old location
-    if (m.promotion == Piece::PIECE_NONE) {
-        pieces[currentTurn + fromPiece] |= toBB;    // add piece to new location
-    }
-    else {
-        pieces[currentTurn + m.promotion] |= toBB;  // promote pawn
-    }
+    st->pieces[st->currentTurn + fromPiece] &= ~fromBB; // remove piece from old location
+    st->hash ^= Zobrist::KEYS.pieceSquare[st->currentTurn + fromPiece][m.from];
+    Piece placedPiece = m.promotion == Piece::PIECE_NONE ? fromPiece : m.promotion;
+    st->pieces[st->currentTurn + placedPiece] |= toBB;  // add piece (or promoted pawn) to new location
+    st->hash ^= Zobrist::KEYS.pieceSquare[st->currentTurn + placedPiece][m.to];
 
     bool isCapture = false;
     if (toPiece != Piece::PIECE_NONE) {
         isCapture = true;
         // if this move is a capture, remove enemy piece
-        pieces[Players::getEnemy(currentTurn) + toPiece] &= ~toBB;
+        st->pieces[Players::getEnemy(st->currentTurn) + toPiece] &= ~toBB;
+        st->hash ^= Zobrist::KEYS.pieceSquare[Players::getEnemy(st->currentTurn) + toPiece][m.to];
 
         // if rook captured, can't castle on that side
         if (toPiece == Piece::ROOK) {
             switch (m.to) {
             case Square::A1:
-                castleAbility.wQueenside = false;
+                st->castleAbility.wQueenside = false;
                 break;
             case Square::H1:
-                castleAbility.wKingside = false;
+                st->castleAbility.wKingside = false;
                 break;
             case Square::A8:
-                castleAbility.bQueenside = false;
+                st->castleAbility.bQueenside = false;
                 break;
             case Square::H8:
-                castleAbility.bKingside = false;
+                st->castleAbility.bKingside = false;
             }
         }
     }
-    else if (fromPiece == Piece::PAWN && m.to == enPassantTarget) {
+    else if (fromPiece == Piece::PAWN && m.to == st->enPassantTarget) {
         isCapture = true;
         // if this move is an en passant, remove enemy pawn
-        Rank r = Squares::getRank(enPassantTarget);
-        File f = Squares::getFile(enPassantTarget);
+        Rank r = Squares::getRank(st->enPassantTarget);
+        File f = Squares::getFile(st->enPassantTarget);
         // enemy pawn is either 1 rank above or 1 rank below en passant target based on player color
-        Square enemyPawnToKill = Squares::fromRankFile(currentTurn == Player::WHITE ? r - 1 : r + 1, f);
-        pieces[Players::getEnemy(currentTurn) + Piece::PAWN] &= ~Bitboards::oneAt(enemyPawnToKill);
+        Square enemyPawnToKill = Squares::fromRankFile(st->currentTurn == Player::WHITE ? r - 1 : r + 1, f);
+        st->pieces[Players::getEnemy(st->currentTurn) + Piece::PAWN] &= ~Bitboards::oneAt(enemyPawnToKill);
+        st->hash ^= Zobrist::KEYS.pieceSquare[Players::getEnemy(st->currentTurn) + Piece::PAWN][enemyPawnToKill];
     }
 
     if (fromPiece == Piece::KING) {
         // if we moved the king, we can no longer castle
-        if (currentTurn == Player::WHITE) {
-            castleAbility.wKingside = false;
-            castleAbility.wQueenside = false;
+        if (st->currentTurn == Player::WHITE) {
+            st->castleAbility.wKingside = false;
+            st->castleAbility.wQueenside = false;
         }
         else {
-            castleAbility.bKingside = false;
-            castleAbility.bQueenside = false;
+            st->castleAbility.bKingside = false;
+            st->castleAbility.bQueenside = false;
         }
 
         if (Squares::getFile(m.from) == File::FILE_E) {
             // if castling kingside
             if (Squares::getFile(m.to) == File::FILE_G) {
                 // move kingside rook. can assume it is at H file because we assume castling is a valid move
-                Bitboard kingsideRook = Bitboards::oneAt(currentTurn == Player::WHITE ? Square::H1 : Square::H8);
-                Bitboard newRookLoc = Bitboards::oneAt(currentTurn == Player::WHITE ? Square::F1 : Square::F8);
-                pieces[currentTurn + Piece::ROOK] &= ~kingsideRook;
-                pieces[currentTurn + Piece::ROOK] |= newRookLoc;
+                Square rookFrom = st->currentTurn == Player::WHITE ? Square::H1 : Square::H8;
+                Square rookTo = st->currentTurn == Player::WHITE ? Square::F1 : Square::F8;
+                st->pieces[st->currentTurn + Piece::ROOK] &= ~Bitboards::oneAt(rookFrom);
+                st->pieces[st->currentTurn + Piece::ROOK] |= Bitboards::oneAt(rookTo);
+                st->hash ^= Zobrist::KEYS.pieceSquare[st->currentTurn + Piece::ROOK][rookFrom] ^ Zobrist::KEYS.pieceSquare[st->currentTurn + Piece::ROOK][rookTo];
             }
             // if castling queenside
             if (Squares::getFile(m.to) == File::FILE_C) {
                 // move queenside rook. can assume it is at A file because we assume castling is a valid move
-                Bitboard queensideRook = Bitboards::oneAt(currentTurn == Player::WHITE ? Square::A1 : Square::A8);
-                Bitboard newRookLoc = Bitboards::oneAt(currentTurn == Player::WHITE ? Square::D1 : Square::D8);
-                pieces[currentTurn + Piece::ROOK] &= ~queensideRook;
-                pieces[currentTurn + Piece::ROOK] |= newRookLoc;
+                Square rookFrom = st->currentTurn == Player::WHITE ? Square::A1 : Square::A8;
+                Square rookTo = st->currentTurn == Player::WHITE ? Square::D1 : Square::D8;
+                st->pieces[st->currentTurn + Piece::ROOK] &= ~Bitboards::oneAt(rookFrom);
+                st->pieces[st->currentTurn + Piece::ROOK] |= Bitboards::oneAt(rookTo);
+                st->hash ^= Zobrist::KEYS.pieceSquare[st->currentTurn + Piece::ROOK][rookFrom] ^ Zobrist::KEYS.pieceSquare[st->currentTurn + Piece::ROOK][rookTo];
             }
         }
     }
@@ -467,101 +920,146 @@ MoveUndoInfo Chessboard::makeMove(Move m) {
         // if we moved a rook, we can no longer castle on that side
         switch (m.from) {
         case Square::A1:
-            castleAbility.wQueenside = false;
+            st->castleAbility.wQueenside = false;
             break;
         case Square::H1:
-            castleAbility.wKingside = false;
+            st->castleAbility.wKingside = false;
             break;
         case Square::A8:
-            castleAbility.bQueenside = false;
+            st->castleAbility.bQueenside = false;
             break;
         case Square::H8:
-            castleAbility.bKingside = false;
+            st->castleAbility.bKingside = false;
         }
     }
 
-    Square oldEnPassantTarget = enPassantTarget;
+    Square oldEnPassantTarget = st->enPassantTarget;
     if (fromPiece == Piece::PAWN && (m.to - m.from == 16 || m.from - m.to == 16))
     {
         // if this move double pushed a pawn, it is now an en passant target
-        enPassantTarget = (Square)(currentTurn == Player::WHITE ? m.from + 8 : m.from - 8);
+        st->enPassantTarget = (Square)(st->currentTurn == Player::WHITE ? m.from + 8 : m.from - 8);
     }
     else {
-        enPassantTarget = Square::SQUARE_NONE;
+        st->enPassantTarget = Square::SQUARE_NONE;
     }
 
-    if (currentTurn == Player::BLACK) {
-        fullMoveNumber++;
+    if (st->currentTurn == Player::BLACK) {
+        st->fullMoveNumber++;
     }
 
-    int oldHalfMoveClock = halfMoveClock;
+    int oldHalfMoveClock = st->halfMoveClock;
     if (isCapture || fromPiece == Piece::PAWN) {
-        halfMoveClock = 0;
+        st->halfMoveClock = 0;
     }
     else {
-        halfMoveClock++;
+        st->halfMoveClock++;
+    }
+
+    // castling rights, en passant file and turn
+    st->hash ^= castleHash(oldCastleAbility) ^ castleHash(st->castleAbility);
+    if (oldEnPassantTarget != Square::SQUARE_NONE) {
+        st->hash ^= Zobrist::KEYS.enPassantFile[Squares::getFile(oldEnPassantTarget)];
+    }
+    if (st->enPassantTarget != Square::SQUARE_NONE) {
+        st->hash ^= Zobrist::KEYS.enPassantFile[Squares::getFile(st->enPassantTarget)];
+    }
+    st->hash ^= Zobrist::KEYS.blackToMove;
+    if (tt != nullptr) {
+        tt->prefetch(st->hash);
     }
 
-    currentTurn = Players::getEnemy(currentTurn);
-    
+    st->currentTurn = Players::getEnemy(st->currentTurn);
+    updateStateInfo();
 
-    return { m, toPiece, oldCastleAbility, oldEnPassantTarget, oldHalfMoveClock };
+    return { m, toPiece, oldCastleAbility, oldEnPassantTarget, oldHalfMoveClock, oldHash };
 }
 
-void Chessboard::undoMove(MoveUndoInfo m) {
-    currentTurn = Players::getEnemy(currentTurn);
+void Chessboard::undoMoveInPlace(MoveUndoInfo m) {
+    st->currentTurn = Players::getEnemy(st->currentTurn);
 
     Bitboard fromBB = Bitboards::oneAt(m.move.from);
     Bitboard toBB = Bitboards::oneAt(m.move.to);
 
-    Piece p = getPieceTypeAtSquareGivenColor(m.move.to, currentTurn);
+    Piece p = getPieceTypeAtSquareGivenColor(m.move.to, st->currentTurn);
 
-    pieces[currentTurn + p] &= ~toBB;  // remove piece from current location
+    st->pieces[st->currentTurn + p] &= ~toBB;  // remove piece from current location
     if (m.move.promotion == Piece::PIECE_NONE) {
-        pieces[currentTurn + p] |= fromBB; // add piece to old location
+        st->pieces[st->currentTurn + p] |= fromBB; // add piece to old location
     }
     else {
-        pieces[currentTurn + Piece::PAWN] |= fromBB; // demote back to pawn
+        st->pieces[st->currentTurn + Piece::PAWN] |= fromBB; // demote back to pawn
     }
 
     if (p == Piece::PAWN && m.move.to == m.enPassantTarget) {
         // bring back captured pawn from en passant
         Rank r = Squares::getRank(m.enPassantTarget);
         File f = Squares::getFile(m.enPassantTarget);
-        Square enemyPawnLoc = Squares::fromRankFile(currentTurn == Player::WHITE ? r - 1 : r + 1, f);
-        pieces[Players::getEnemy(currentTurn) + Piece::PAWN] |= Bitboards::oneAt(enemyPawnLoc);
+        Square enemyPawnLoc = Squares::fromRankFile(st->currentTurn == Player::WHITE ? r - 1 : r + 1, f);
+        st->pieces[Players::getEnemy(st->currentTurn) + Piece::PAWN] |= Bitboards::oneAt(enemyPawnLoc);
     }
     else if (m.captured != Piece::PIECE_NONE) {
         // bring captured piece back on the board
-        pieces[Players::getEnemy(currentTurn) + m.captured] |= toBB;
+        st->pieces[Players::getEnemy(st->currentTurn) + m.captured] |= toBB;
     }
 
     if (p == Piece::KING) {
         if (Squares::getFile(m.move.from) == File::FILE_E) {
             if (Squares::getFile(m.move.to) == File::FILE_G) {
                 // undo kingside castle
-                Bitboard originalLoc = Bitboards::oneAt(currentTurn == Player::WHITE ? Square::H1 : Square::H8);
-                Bitboard curLoc = Bitboards::oneAt(currentTurn == Player::WHITE ? Square::F1 : Square::F8);
-                pieces[currentTurn + Piece::ROOK] &= ~curLoc;
-                pieces[currentTurn + Piece::ROOK] |= originalLoc;
+                Bitboard originalLoc = Bitboards::oneAt(st->currentTurn == Player::WHITE ? Square::H1 : Square::H8);
+                Bitboard curLoc = Bitboards::oneAt(st->currentTurn == Player::WHITE ? Square::F1 : Square::F8);
+                st->pieces[st->currentTurn + Piece::ROOK] &= ~curLoc;
+                st->pieces[st->currentTurn + Piece::ROOK] |= originalLoc;
             }
             if (Squares::getFile(m.move.to) == File::FILE_C) {
                 // undo queenside castle
-                Bitboard originalLoc = Bitboards::oneAt(currentTurn == Player::WHITE ? Square::A1 : Square::A8);
-                Bitboard curLoc = Bitboards::oneAt(currentTurn == Player::WHITE ? Square::D1 : Square::D8);
-                pieces[currentTurn + Piece::ROOK] &= ~curLoc;
-                pieces[currentTurn + Piece::ROOK] |= originalLoc;
+                Bitboard originalLoc = Bitboards::oneAt(st->currentTurn == Player::WHITE ? Square::A1 : Square::A8);
+                Bitboard curLoc = Bitboards::oneAt(st->currentTurn == Player::WHITE ? Square::D1 : Square::D8);
+                st->pieces[st->currentTurn + Piece::ROOK] &= ~curLoc;
+                st->pieces[st->currentTurn + Piece::ROOK] |= originalLoc;
             }
         }
     }
 
-    if (currentTurn == Player::BLACK) {
-        fullMoveNumber--;
+    if (st->currentTurn == Player::BLACK) {
+        st->fullMoveNumber--;
     }
 
-    castleAbility = m.castleAbility;
-    enPassantTarget = m.enPassantTarget;
-    halfMoveClock = m.halfMoveClock;
+    st->castleAbility = m.castleAbility;
+    st->enPassantTarget = m.enPassantTarget;
+    st->halfMoveClock = m.halfMoveClock;
+    st->hash = m.hash;
+    updateStateInfo();
+}
+
+bool Chessboard::isRepetition() {
+    // positions with the same side to move are 2 plies apart, and it takes at least 4 plies to get back
+    int end = std::min(st->halfMoveClock, (int)(st - states.data()));
+    for (int i = 4; i <= end; i += 2) {
+        if ((st - i)->hash == st->hash) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Chessboard::hasUpcomingRepetition(int ply) {
+    int end = std::min(st->halfMoveClock, (int)(st - states.data()));
+    if (end < 3) {
+        return false;
+    }
+
+    // compare against positions with the other side to move, which one more move by us could reach
+    Bitboard allPieces = getAllPieces();
+    for (int i = 3; i <= end && i < ply; i += 2) {
+        uint64_t moveKey = st->hash ^ (st - i)->hash;
+        Square from;
+        Square to;
+        if (Cuckoo::lookup(moveKey, from, to) && (Bitboards::BETWEEN[from][to] & allPieces) == 0) {
+            return true;
+        }
+    }
+    return false;
 }
 
 unsigned long Chessboard::perft(int depth) {
@@ -590,7 +1088,7 @@ unsigned long Chessboard::psuedolegalPerft(int depth) {
     std::vector<Move> moves = generateAllPseudolegalMoves();
     for (Move& m : moves) {
         MoveUndoInfo moveInfo = makeMove(m);
-        if (!isChecked(Players::getEnemy(currentTurn))) {
+        if (!isChecked(Players::getEnemy(st->currentTurn))) {
             numMoves += psuedolegalPerft(depth - 1);
         }
         undoMove(moveInfo);
@@ -625,40 +1123,40 @@ std::string Chessboard::toFEN() {
         for (int f = FILE_A; f <= FILE_H; f++) {
             isEmptySquare = false;
             char piece;
-            if (Bitboards::contains(pieces[Player::WHITE + Piece::PAWN], Squares::fromRankFile(r, f))) {
+            if (Bitboards::contains(st->pieces[Player::WHITE + Piece::PAWN], Squares::fromRankFile(r, f))) {
                 piece = 'P';
             } 
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::PAWN], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::PAWN], Squares::fromRankFile(r, f))) {
                 piece = 'p';
             } 
-            else if (Bitboards::contains(pieces[Player::WHITE + Piece::KNIGHT], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::WHITE + Piece::KNIGHT], Squares::fromRankFile(r, f))) {
                 piece = 'N';
             }
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::KNIGHT], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::KNIGHT], Squares::fromRankFile(r, f))) {
                 piece = 'n';
             }
-            else if (Bitboards::contains(pieces[Player::WHITE + Piece::BISHOP], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::WHITE + Piece::BISHOP], Squares::fromRankFile(r, f))) {
                 piece = 'B';
             }
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::BISHOP], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::BISHOP], Squares::fromRankFile(r, f))) {
                 piece = 'b';
             }
-            else if (Bitboards::contains(pieces[Player::WHITE + Piece::ROOK], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::WHITE + Piece::ROOK], Squares::fromRankFile(r, f))) {
                 piece = 'R';
             }
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::ROOK], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::ROOK], Squares::fromRankFile(r, f))) {
                 piece = 'r';
             }
-            else if (Bitboards::contains(pieces[Player::WHITE + Piece::QUEEN], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::WHITE + Piece::QUEEN], Squares::fromRankFile(r, f))) {
                 piece = 'Q';
             }
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::QUEEN], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::QUEEN], Squares::fromRankFile(r, f))) {
                 piece = 'q';
             }
-            else if (Bitboards::contains(pieces[Player::WHITE + Piece::KING], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::WHITE + Piece::KING], Squares::fromRankFile(r, f))) {
                 piece = 'K';
             }
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::KING], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::KING], Squares::fromRankFile(r, f))) {
                 piece = 'k';
             }
             else {
@@ -668,12 +1166,15 @@ std::string Chessboard::toFEN() {
 
             if (!isEmptySquare) {
                 if (numEmpties != 0) {
-                    out << '0' + numEmpties;
+                    out << numEmpties;
                     numEmpties = 0;
                 }
                 out << piece;
             }
         }
+        if (numEmpties != 0) {
+            out << numEmpties;
+        }
         
         out << "/";
     }
@@ -682,26 +1183,29 @@ std::string Chessboard::toFEN() {
     out << " "; 
 
     // current turn
-    out << (currentTurn == Player::WHITE ? 'w' : 'b');
+    out << (st->currentTurn == Player::WHITE ? 'w' : 'b');
     out << " ";
 
     // castle rights
-    out << (castleAbility.wKingside  ? "K" : "");
-    out << (castleAbility.wQueenside ? "Q" : "");
-    out << (castleAbility.bKingside  ? "k" : "");
-    out << (castleAbility.bQueenside ? "q" : "");
+    out << (st->castleAbility.wKingside  ? "K" : "");
+    out << (st->castleAbility.wQueenside ? "Q" : "");
+    out << (st->castleAbility.bKingside  ? "k" : "");
+    out << (st->castleAbility.bQueenside ? "q" : "");
+    if (!st->castleAbility.wKingside && !st->castleAbility.wQueenside && !st->castleAbility.bKingside && !st->castleAbility.bQueenside) {
+        out << "-";
+    }
     out << " ";
 
     // en passant
-    out << (enPassantTarget == Square::SQUARE_NONE ? "-" : Squares::toAlgebraic(enPassantTarget));
+    out << (st->enPassantTarget == Square::SQUARE_NONE ? "-" : Squares::toAlgebraic(st->enPassantTarget));
     out << " ";
 
     // half move clock
-    out << std::to_string(halfMoveClock);
+    out << std::to_string(st->halfMoveClock);
     out << " ";
 
     // full move number
-    out << std::to_string(fullMoveNumber);
+    out << std::to_string(st->fullMoveNumber);
 
     return out.str();
 }
@@ -710,40 +1214,40 @@ std::string Chessboard::toString() {
     std::string out = "";
     for (int r = RANK_8; r >= RANK_1; r--) {
         for (int f = FILE_A; f <= FILE_H; f++) {
-            if (Bitboards::contains(pieces[Player::WHITE + Piece::PAWN], Squares::fromRankFile(r, f))) {
+            if (Bitboards::contains(st->pieces[Player::WHITE + Piece::PAWN], Squares::fromRankFile(r, f))) {
                 out += "P";
             }
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::PAWN], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::PAWN], Squares::fromRankFile(r, f))) {
                 out += "p";
             }
-            else if (Bitboards::contains(pieces[Player::WHITE + Piece::KNIGHT], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::WHITE + Piece::KNIGHT], Squares::fromRankFile(r, f))) {
                 out += "N";
             }
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::KNIGHT], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::KNIGHT], Squares::fromRankFile(r, f))) {
                 out += "n";
             }
-            else if (Bitboards::contains(pieces[Player::WHITE + Piece::BISHOP], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::WHITE + Piece::BISHOP], Squares::fromRankFile(r, f))) {
                 out += "B";
             }
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::BISHOP], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::BISHOP], Squares::fromRankFile(r, f))) {
                 out += "b";
             }
-            else if (Bitboards::contains(pieces[Player::WHITE + Piece::ROOK], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::WHITE + Piece::ROOK], Squares::fromRankFile(r, f))) {
                 out += "R";
             }
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::ROOK], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::ROOK], Squares::fromRankFile(r, f))) {
                 out += "r";
             }
-            else if (Bitboards::contains(pieces[Player::WHITE + Piece::QUEEN], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::WHITE + Piece::QUEEN], Squares::fromRankFile(r, f))) {
                 out += "Q";
             }
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::QUEEN], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::QUEEN], Squares::fromRankFile(r, f))) {
                 out += "q";
             }
-            else if (Bitboards::contains(pieces[Player::WHITE + Piece::KING], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::WHITE + Piece::KING], Squares::fromRankFile(r, f))) {
                 out += "K";
             }
-            else if (Bitboards::contains(pieces[Player::BLACK + Piece::KING], Squares::fromRankFile(r, f))) {
+            else if (Bitboards::contains(st->pieces[Player::BLACK + Piece::KING], Squares::fromRankFile(r, f))) {
                 out += "k";
             }
             else {
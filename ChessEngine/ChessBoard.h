@@ -5,6 +5,8 @@
 #include <vector>
 
 #include "Bitboard.h"
+#include "PackedPosition.h"
+#include "Zobrist.h"
 
 /***
  * Helper struct containing the castling permissions of each side
@@ -37,6 +39,20 @@ enum Piece {
     PIECE_NONE
 };
 
+/***
+ * Which pseudolegal moves to generate
+ *   GEN_ALL      - every move
+ *   GEN_CAPTURES - captures (including en passant) and promotions
+ *   GEN_QUIETS   - every other move, including castling
+ *   GEN_EVASIONS - moves that may get out of check: king moves, and captures of or blocks against a single checker
+ */
+enum GenType {
+    GEN_ALL,
+    GEN_CAPTURES,
+    GEN_QUIETS,
+    GEN_EVASIONS
+};
+
 struct Move {
     Square from;
     Square to;
@@ -46,19 +62,49 @@ struct Move {
 
 namespace Moves {
     std::string toString(Move& m);
+
+    /***
+     * Parses a move in UCI notation (ex: e2e4, e7e8q) without allocating.
+     * Returns false if the text isn't a move. The move isn't checked for legality.
+     */
+    bool fromString(const std::string& s, Move& outMove);
 }
 
+class TranspositionTable;
+
 struct MoveUndoInfo {
     Move move;
     Piece captured;
     CastleAbility castleAbility;
     Square enPassantTarget;
     int halfMoveClock;
+    uint64_t hash;
 };
 
-class Chessboard
-{
-private:
+/***
+ * Facts about a position for the side to move, computed once when the position is reached so that
+ * move generation, legality checks and the search read them instead of recomputing attacks per move
+ */
+struct StateInfo {
+    Bitboard checkers = 0;     // enemy pieces giving check
+    Bitboard pinned = 0;       // own pieces that can't leave the line between the king and an enemy slider
+    Bitboard enemyAttacks = 0; // squares attacked by the enemy, with the king removed so it can't step back along a checking line
+
+    // squares from which a bishop/rook of the side to move would check the enemy king
+    Bitboard diagonalCheckSquares = 0;
+    Bitboard straightCheckSquares = 0;
+    Bitboard discoveredCheckers = 0; // own pieces whose move off the line to the enemy king uncovers a check by a slider
+
+    // the rest is only needed for king moves and check detection, so it's computed on first use
+    bool enemyAttacksValid = false;
+    bool checkInfoValid = false;
+};
+
+/***
+ * Everything about a position that a move changes. Aligned to cache lines so copying one touches no others.
+ * With the StateInfo it takes three of them (192 bytes).
+ */
+struct alignas(64) BoardState {
     Bitboard pieces[12] = { }; // bitboards for each piece type and color (6 white piece boards, 6 black piece boards)
                                // board index accessible by performing Piece + Player (ex pieces[PAWN + WHITE] = white pawns bitboard)
 
@@ -67,32 +113,59 @@ private:
     Square enPassantTarget;
     int halfMoveClock;
     int fullMoveNumber;
+    uint64_t hash = 0; // Zobrist hash, updated incrementally by makeMove
+    StateInfo info;    // recomputed by makeMove
+};
+
+class Chessboard
+{
+private:
+    static const int INITIAL_STATE_STACK_SIZE = 128;
+
+    // piece values used by see, independent of the tuned evaluation. Kings are never captured in an exchange.
+    static constexpr int SEE_VALUES[6] = { 100, 300, 300, 500, 900, 0 };
+
+    /*
+     * Copy-make: states[0] is the loaded position and each entry after it is the position after one more
+     * move, up to the current position st. makeMove copies the current state to the next entry and changes
+     * the copy, so undoMove only has to step st back. The entries before st are also the history of
+     * earlier positions used to detect repetitions.
+     */
+    std::vector<BoardState> states = std::vector<BoardState>(INITIAL_STATE_STACK_SIZE);
+    BoardState* st = states.data();
 
     /***
-     * The following functions generate all pseudo legal moves for the given piece type and store
-     * the generated moves in outMoveArray.
+     * Computes the Zobrist hash of the position from scratch
      */
-    void generatePawnMoves(std::vector<Move>& outMoveArray);
-    void generateKnightMoves(std::vector<Move>& outMoveArray);
-    void generateBishopMoves(std::vector<Move>& outMoveArray);
-    void generateRookMoves(std::vector<Move>& outMoveArray);
-    void generateQueenMoves(std::vector<Move>& outMoveArray);
-    void generateKingMoves(std::vector<Move>& outMoveArray);
+    uint64_t computeHash();
 
     /***
-     * Return a bitboard containing all of the pieces on the board.
+     * Returns the hash of a set of castling permissions
      */
-    Bitboard getAllPieces() { return getAllPiecesByColor(Player::WHITE) | getAllPiecesByColor(Player::BLACK); }
+    static uint64_t castleHash(CastleAbility c);
 
     /***
-     * Return a bitboard containing all of the pieces of a certain color
+     * Computes the StateInfo of the current position from scratch, except for enemyAttacks
      */
-    Bitboard getAllPiecesByColor(Player color);
+    void updateStateInfo();
+    void updateEnemyAttacks();
+    void updateCheckInfo();
 
     /***
-     * Return true if a given player is attacking a specified square.
+     * The following functions generate pseudo legal moves of a type for the side Us and store them in
+     * outMoveArray. They are templates so that color dependent values (pawn direction, promotion
+     * rank, castling squares) are resolved at compile time.
+     *
+     * Only moves to squares in targets are generated.
      */
-    bool isAttacking(Player player, Square sq);
+    template <Player Us, GenType Type>
+    void generatePawnMoves(std::vector<Move>& outMoveArray, Bitboard targets);
+    template <Player Us, Piece P>
+    void generatePieceMoves(std::vector<Move>& outMoveArray, Bitboard targets);
+    template <Player Us, GenType Type>
+    void generateKingMoves(std::vector<Move>& outMoveArray);
+    template <Player Us, GenType Type>
+    void generateMoves(std::vector<Move>& outMoveArray);
 
 public:
     /***
@@ -105,11 +178,61 @@ public:
      */
     Chessboard(std::string fen);
 
+    /***
+     * Load a chess game state from a packed binary record (see PackedPosition.h)
+     */
+    Chessboard(const PackedPosition& packed);
+
+    /***
+     * st points into states, so copies have to point it into their own stack
+     */
+    Chessboard(const Chessboard& other);
+    Chessboard& operator=(const Chessboard& other);
+    Chessboard(Chessboard&& other) = default;
+    Chessboard& operator=(Chessboard&& other) = default;
+
     /***
      * Returns the current player
      */
     Player getTurn();
 
+    /***
+     * Returns the number of half moves since the last capture or pawn move
+     */
+    int getHalfMoveClock() { return st->halfMoveClock; }
+
+    /***
+     * Returns the castling permissions of each side
+     */
+    CastleAbility getCastleAbility() { return st->castleAbility; }
+
+    /***
+     * Returns the square that can be captured onto en passant, or SQUARE_NONE
+     */
+    Square getEnPassantTarget() { return st->enPassantTarget; }
+
+    /***
+     * Returns the Zobrist hash of the position
+     */
+    uint64_t getHash() { return st->hash; }
+
+    /***
+     * Returns true if the current position occurred before. Only positions since the last capture or
+     * pawn move are compared, since no earlier position can repeat.
+     */
+    bool isRepetition();
+
+    /***
+     * Returns true if 50 moves were made by each side without a capture or pawn move
+     */
+    bool isFiftyMoveDraw() { return st->halfMoveClock >= 100; }
+
+    /***
+     * Returns true if the side to move has a reversible move that repeats a position reached within the
+     * last `ply` plies (ex: the current search line). Lets the search score a draw one move before it happens.
+     */
+    bool hasUpcomingRepetition(int ply);
+
     /***
      * Return a string representation of the board, used for debugging
      */
@@ -120,11 +243,21 @@ public:
      */
     std::string toFEN();
 
+    /***
+     * Return the board as a packed binary record. The score and result labels are left as 0.
+     */
+    PackedPosition toPacked();
+
     /***
      * Count the number of pieces of a certain type and color
      */
     int countPieces(Player player, Piece piece);
 
+    /***
+     * Return the bitboard of pieces of a certain type and color
+     */
+    Bitboard getPieces(Player player, Piece piece) { return st->pieces[player + piece]; }
+
     /***
      * Get the type of a piece at a given square given that it is of a
      * certain color
@@ -134,7 +267,13 @@ public:
     /***
      * Generate all pseudolegal moves for the current position for the current player
      */
-    std::vector<Move> generateAllPseudolegalMoves();
+    std::vector<Move> generateAllPseudolegalMoves() { return generatePseudolegalMoves(GEN_ALL); }
+
+    /***
+     * Generate the pseudolegal moves of a type (see GenType) for the current player.
+     * GEN_EVASIONS should only be used when the current player is in check.
+     */
+    std::vector<Move> generatePseudolegalMoves(GenType type);
 
     /***
      * Generate all legal moves for the current position
@@ -142,21 +281,95 @@ public:
     std::vector<Move> generateAllLegalMoves();
 
     /***
-     * Performs a given legal move on the board.
-     * Returns a struct containing information necessary to undo the move.
+     * Performs a given legal move on the board by pushing a new state (copy-make).
+     * Returns a struct containing information about the move.
+     *
+     * If tt is given, the entry of the new position is prefetched as soon as its hash is known,
+     * so the memory access overlaps with the rest of the move instead of stalling the next probe.
      */
-    MoveUndoInfo makeMove(Move m);
+    MoveUndoInfo makeMove(Move m, const TranspositionTable* tt = nullptr);
 
     /***
-     * Undo a move on the board, given information about the move.
+     * Undo the last move made by makeMove
      */
     void undoMove(MoveUndoInfo m);
 
     /***
-     * Return true if a given player is under check
+     * Performs/undoes a move by modifying the current state instead of pushing a new one (make/unmake).
+     * Positions reached this way aren't recorded for repetition detection. Kept to compare against
+     * copy-make in ChessEngineBench, which measured copy-make as faster.
+     */
+    MoveUndoInfo makeMoveInPlace(Move m, const TranspositionTable* tt = nullptr);
+    void undoMoveInPlace(MoveUndoInfo m);
+
+    /***
+     * Returns true if a pseudolegal move of the current player doesn't leave its king in check
+     */
+    bool isLegal(Move m);
+
+    /***
+     * Returns true if a legal move of the current player checks the enemy king, without making it
+     * (except for castling, en passant and promotions, which are rare enough to be played out)
+     */
+    bool givesCheck(Move m);
+
+    /***
+     * Return true if a given player is under check. Free for the current player, whose checkers are stored.
      */
     bool isChecked(Player p);
 
+    /***
+     * Returns the enemy pieces giving check to the current player
+     */
+    Bitboard getCheckers() { return st->info.checkers; }
+
+    /***
+     * Returns the current player's pieces that are pinned to its king
+     */
+    Bitboard getPinned() { return st->info.pinned; }
+
+    /***
+     * Returns the squares attacked by the enemy of the current player
+     */
+    Bitboard getEnemyAttacks() {
+        if (!st->info.enemyAttacksValid) {
+            updateEnemyAttacks();
+        }
+        return st->info.enemyAttacks;
+    }
+
+    /***
+     * Return true if a given player is attacking a specified square.
+     */
+    bool isAttacking(Player player, Square sq);
+
+    /***
+     * Return the pieces of a given player that attack a specified square
+     */
+    Bitboard getAttackers(Player player, Square sq);
+
+    /***
+     * Return the pieces of both players that attack a square if only the squares in occupied were occupied
+     */
+    Bitboard getAllAttackers(Square sq, Bitboard occupied);
+
+    /***
+     * Static exchange evaluation: the material the current player wins (in centipawns, negative if it loses)
+     * by playing a move and then both sides capturing on its destination square, least valuable piece first,
+     * for as long as it pays off. Pieces behind an attacker on the same line join in once it has captured.
+     */
+    int see(Move m);
+
+    /***
+     * Return a bitboard containing all of the pieces on the board.
+     */
+    Bitboard getAllPieces() { return getAllPiecesByColor(Player::WHITE) | getAllPiecesByColor(Player::BLACK); }
+
+    /***
+     * Return a bitboard containing all of the pieces of a certain color
+     */
+    Bitboard getAllPiecesByColor(Player color);
+
     /***
      * Counts the number of legal moves at a certain depth.
      * Used for debugging purposes.
@@ -1,24 +1,74 @@
 
+#include <charconv>
+#include <chrono>
 #include <iostream>
+#include <fstream>
+#include <intrin.h>
+#include <mutex>
 #include <sstream>
 #include <random>
 
 #include "ChessEngine.h"
+#include "Memory.h"
+#include "TunedParams.h"
 
 const int ChessEngine::pieceValues[] = {
-       100,             // pawn
-       300,             // knight
-       300,             // bishop
-       500,             // rook
-       900,             // queen
+       TunedParams::PIECE_VALUES[Piece::PAWN],
+       TunedParams::PIECE_VALUES[Piece::KNIGHT],
+       TunedParams::PIECE_VALUES[Piece::BISHOP],
+       TunedParams::PIECE_VALUES[Piece::ROOK],
+       TunedParams::PIECE_VALUES[Piece::QUEEN],
        WHITE_CHECKMATE  // king
 };
 
 ChessEngine::ChessEngine() {
     Bitboards::initPieceMoveBoards();
+    for (Move& m : excludedMove) {
+        m = { Square::SQUARE_NONE, Square::SQUARE_NONE };
+    }
+}
+
+/***
+ * Parses a number sent by the GUI, clamped to [min, max]. Returns false and leaves outValue
+ * unchanged if the text isn't a number, so malformed commands are ignored instead of throwing.
+ */
+template <typename T>
+static bool parseNumber(const std::string& s, T min, T max, T& outValue) {
+    T value;
+    std::from_chars_result result = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (result.ec == std::errc::result_out_of_range) {
+        value = s[0] == '-' ? min : max;
+    }
+    else if (result.ec != std::errc() || result.ptr != s.data() + s.size()) {
+        return false;
+    }
+    outValue = std::max(min, std::min(max, value));
+    return true;
+}
+
+// times in "go" are capped (at ~24 days) so the time budget arithmetic can't overflow
+static const int64_t MAX_GO_TIME = INT_MAX;
+
+uint64_t ChessEngine::exclusionKey(Move m) {
+    return (TranspositionTable::packMove(m) + 1) * 0x9E3779B97F4A7C15ull;
+}
+
+ChessEngine::~ChessEngine() {
+    stopSearchThread();
+}
+
+/***
+ * Outputs a line. Lines may come from both the UCI thread and the search thread, so output is serialized.
+ */
+static void print(std::string s) {
+    static std::mutex outputMutex;
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::cout << s.c_str() << std::endl;
 }
 
 int ChessEngine::evaluate() {
+    Profiler::ScopedTimer timer(ProfileStage::EVALUATION);
+
     // if its our turn and the enemy king is already under attack, we win!
     // this is used to prevent choosing illegal moves
     if (board.isChecked(Players::getEnemy(board.getTurn()))) {
@@ -33,6 +83,18 @@ int ChessEngine::evaluate() {
         eval -= board.countPieces(Player::BLACK, (Piece)p) * pieceValues[p];
     }
 
+    // evaluate based on piece locations. tables are from white's perspective, so mirror the rank for black
+    for (int p = Piece::PAWN; p <= Piece::KING; p++) {
+        Bitboard white = board.getPieces(Player::WHITE, (Piece)p);
+        while (white) {
+            eval += TunedParams::PSQT[p][Bitboards::popLSB(white)];
+        }
+        Bitboard black = board.getPieces(Player::BLACK, (Piece)p);
+        while (black) {
+            eval -= TunedParams::PSQT[p][Bitboards::popLSB(black) ^ 56];
+        }
+    }
+
     // add a little bit of randomness just to make moves more interesting when 
     // there is no piece value differences
     std::uniform_int_distribution<int> dist(-5, 5);
@@ -42,76 +104,789 @@ int ChessEngine::evaluate() {
 }
 
 Move ChessEngine::search(int depth) {
+    SearchLimits limits;
+    limits.depth = depth;
+    return iterativeDeepening(limits, false);
+}
+
+Move ChessEngine::iterativeDeepening(const SearchLimits& limits, bool report) {
+    stats.reset();
+    searchAborted = false;
+    lines.clear();
+    stats.nodes++;
+    STATS_INC_PLY(stats, 0);
+
     std::vector<Move> moves = generateSortedMoves();
-    int bestEval = board.getTurn() == Player::WHITE ? INT_MIN : INT_MAX; // initialize to worst case
+    if (moves.empty()) {
+        lastEval = 0;
+        return { Square::SQUARE_NONE, Square::SQUARE_NONE };
+    }
+    if (!limits.searchMoves.empty()) {
+        std::vector<Move> allowed;
+        for (Move& m : moves) {
+            for (const Move& s : limits.searchMoves) {
+                if (m.from == s.from && m.to == s.to && m.promotion == s.promotion) {
+                    allowed.push_back(m);
+                    break;
+                }
+            }
+        }
+        if (!allowed.empty()) {
+            moves = allowed;
+        }
+    }
+    if (tablebases.getCardinality() > 0) {
+        filterTablebaseMoves(moves);
+    }
+
+    // a mate search either proves a mate or falls back to the normal search
+    if (limits.mate > 0 && (findMate(limits.mate, moves, report) || searchAborted)) {
+        return moves[0];
+    }
+
+    int maxDepth = limits.depth > 0 ? std::min(limits.depth, MAX_PLY - 1) : MAX_PLY - 1;
+    int numLines = std::min(multiPV, (int)moves.size());
     Move bestMove = moves[0];
+    for (int depth = 1; depth <= maxDepth; depth++) {
+        // each line excludes the root moves of the lines before it. Its subtrees overlap with theirs,
+        // so most of it is answered by the transposition table
+        std::vector<SearchLine> depthLines;
+        for (int pvIdx = 0; pvIdx < numLines && !searchAborted; pvIdx++) {
+            int eval = searchRoot(depth, moves, pvIdx);
+            depthLines.push_back({ eval, std::vector<Move>(pv[0], pv[0] + pvLength[0]) });
+            extendLineFromTT(depthLines.back().moves, depth);
 
-    for (Move& move : moves) {
-        MoveUndoInfo moveInfo = board.makeMove(move);
-        int eval = evalAtDepth(depth - 1, INT_MIN, INT_MAX);
-        if ((board.getTurn() == Player::BLACK && eval > bestEval) || // was white turn
-            (board.getTurn() == Player::WHITE && eval < bestEval)) { // was black turn
-            bestEval = eval;
-            bestMove = move;
+            // a later line may score better than an earlier one since the table changed in between, keep them sorted
+            for (int i = pvIdx; i > 0; i--) {
+                bool better = board.getTurn() == Player::WHITE ? depthLines[i].eval > depthLines[i - 1].eval :
+                    depthLines[i].eval < depthLines[i - 1].eval;
+                if (!better) {
+                    break;
+                }
+                std::swap(depthLines[i], depthLines[i - 1]);
+                std::swap(moves[i], moves[i - 1]);
+            }
+        }
+        if (searchAborted) {
+            break; // results of an unfinished depth can't be trusted
+        }
+        lines = depthLines;
+        bestMove = moves[0];
+        lastEval = lines[0].eval;
+
+        if (report) {
+            for (int i = 0; i < numLines; i++) {
+                std::string line = "info depth " + std::to_string(depth) + " multipv " + std::to_string(i + 1) +
+                    " score " + toUCIScore(lines[i].eval) + " nodes " + std::to_string(stats.nodes) +
+                    " time " + std::to_string(elapsedTime()) + " hashfull " + std::to_string(tt.hashfull()) + " pv";
+                for (Move& m : lines[i].moves) {
+                    line += " " + Moves::toString(m);
+                }
+                print(line);
+            }
+        }
+
+        // a new depth takes longer than all previous ones, so don't start one that likely won't finish
+        if (timeBudget > 0 && !pondering && elapsedTime() > timeBudget / 2) {
+            break;
         }
-        board.undoMove(moveInfo);
     }
 
     return bestMove;
 }
 
-int ChessEngine::evalAtDepth(int depth, int alpha, int beta) {
-    if (depth == 0) {
-        return evaluate();
+Move ChessEngine::searchMate(int maxMoves) {
+    stats.reset();
+    searchAborted = false;
+    lines.clear();
+
+    std::vector<Move> moves = board.generateAllLegalMoves();
+    if (!findMate(maxMoves, moves, false)) {
+        return { Square::SQUARE_NONE, Square::SQUARE_NONE };
+    }
+    return moves[0];
+}
+
+bool ChessEngine::findMate(int maxMoves, std::vector<Move>& moves, bool report) {
+    for (int n = 1; n <= maxMoves && 2 * n - 1 < MAX_PLY; n++) {
+        for (int i = 0; i < (int)moves.size(); i++) {
+            MoveUndoInfo moveInfo = makeMove(moves[i]);
+            bool mated = mateSearch(2 * n - 2, 1);
+            undoMove(moveInfo);
+            if (searchAborted) {
+                return false;
+            }
+            if (!mated) {
+                continue;
+            }
+
+            std::rotate(moves.begin(), moves.begin() + i, moves.begin() + i + 1);
+            std::vector<Move> line = { moves[0] };
+            line.insert(line.end(), pv[1] + 1, pv[1] + pvLength[1]);
+            lastEval = board.getTurn() == Player::WHITE ? WHITE_CHECKMATE - (2 * n - 1) : BLACK_CHECKMATE + (2 * n - 1);
+            lines = { { lastEval, line } };
+
+            if (report) {
+                std::string info = "info depth " + std::to_string(2 * n - 1) + " score " + toUCIScore(lastEval) +
+                    " nodes " + std::to_string(stats.nodes) + " time " + std::to_string(elapsedTime()) + " pv";
+                for (Move& m : line) {
+                    info += " " + Moves::toString(m);
+                }
+                print(info);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ChessEngine::mateSearch(int pliesLeft, int ply) {
+    stats.nodes++;
+    STATS_INC_PLY(stats, ply);
+    pvLength[ply] = ply;
+
+    if ((stats.nodes & 1023) == 0) {
+        checkTime();
+    }
+    if (searchAborted) {
+        return false;
+    }
+
+    // the attacker moves at even plies
+    bool attacking = ply % 2 == 0;
+    std::vector<Move> moves = board.generateAllLegalMoves();
+    if (moves.empty()) {
+        return !attacking && board.isChecked(board.getTurn());
+    }
+    if (pliesLeft == 0 || ply >= MAX_PLY - 1 || board.isRepetition() || board.isFiftyMoveDraw()) {
+        return false;
+    }
+
+    if (attacking) {
+        // checks are the most forcing moves so they're tried first, and the only moves that can mate in one
+        std::vector<Move> ordered;
+        std::vector<Move> quiet;
+        for (Move& m : moves) {
+            if (board.givesCheck(m)) {
+                ordered.push_back(m);
+            }
+            else if (pliesLeft > 1) {
+                quiet.push_back(m);
+            }
+        }
+        ordered.insert(ordered.end(), quiet.begin(), quiet.end());
+
+        for (Move& m : ordered) {
+            MoveUndoInfo moveInfo = makeMove(m);
+            bool mated = mateSearch(pliesLeft - 1, ply + 1);
+            undoMove(moveInfo);
+            if (searchAborted) {
+                return false;
+            }
+            if (mated) {
+                pv[ply][ply] = m;
+                for (int i = ply + 1; i < pvLength[ply + 1]; i++) {
+                    pv[ply][i] = pv[ply + 1][i];
+                }
+                pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // every defense has to be mated, and the principal variation follows the one that lasts longest
+    std::vector<Move> longestLine;
+    for (Move& m : moves) {
+        MoveUndoInfo moveInfo = makeMove(m);
+        bool mated = mateSearch(pliesLeft - 1, ply + 1);
+        undoMove(moveInfo);
+        if (searchAborted || !mated) {
+            return false;
+        }
+        if (pvLength[ply + 1] - ply > (int)longestLine.size()) {
+            longestLine.assign(1, m);
+            longestLine.insert(longestLine.end(), pv[ply + 1] + ply + 1, pv[ply + 1] + pvLength[ply + 1]);
+        }
+    }
+    std::copy(longestLine.begin(), longestLine.end(), pv[ply] + ply);
+    pvLength[ply] = ply + (int)longestLine.size();
+    return true;
+}
+
+int ChessEngine::searchRoot(int depth, std::vector<Move>& moves, int firstMove) {
+    int alpha = INT_MIN;
+    int beta = INT_MAX;
+    int bestEval = board.getTurn() == Player::WHITE ? INT_MIN : INT_MAX; // initialize to worst case
+    int bestIdx = firstMove;
+    pvLength[0] = 0;
+    rootDepth = depth;
+
+    for (int i = firstMove; i < (int)moves.size(); i++) {
+        MoveUndoInfo moveInfo = makeMove(moves[i]);
+        int eval = evalAtDepth(depth - 1, 1, alpha, beta);
+        undoMove(moveInfo);
+        if (searchAborted) {
+            return bestEval;
+        }
+
+        if ((board.getTurn() == Player::WHITE && eval > bestEval) ||
+            (board.getTurn() == Player::BLACK && eval < bestEval)) {
+            bestEval = eval;
+            bestIdx = i;
+            pv[0][0] = moves[i];
+            for (int j = 1; j < pvLength[1]; j++) {
+                pv[0][j] = pv[1][j];
+            }
+            pvLength[0] = std::max(pvLength[1], 1);
+
+            if (board.getTurn() == Player::WHITE) {
+                alpha = bestEval;
+            }
+            else {
+                beta = bestEval;
+            }
+        }
+    }
+
+    // search the best move first at the next depth
+    std::rotate(moves.begin() + firstMove, moves.begin() + bestIdx, moves.begin() + bestIdx + 1);
+    if (firstMove == 0) {
+        // with moves excluded the result isn't the score of the position
+        Profiler::ScopedTimer ttTimer(ProfileStage::TT_PROBE);
+        tt.store(board.getHash(), depth, scoreToTT(bestEval, 0), BOUND_EXACT, moves[0]);
+    }
+    return bestEval;
+}
+
+int ChessEngine::evalAtDepth(int depth, int ply, int alpha, int beta) {
+    stats.nodes++;
+    STATS_INC_PLY(stats, ply);
+    pvLength[ply] = ply;
+
+    if ((stats.nodes & 1023) == 0) {
+        checkTime();
+    }
+    if (searchAborted) {
+        return 0;
+    }
+
+    // repeating a position or reaching the 50 move rule ends the line in a draw
+    if (board.isRepetition() || board.isFiftyMoveDraw()) {
+        STATS_INC(stats, repetitionDraws);
+        return 0;
+    }
+
+    // if the side to move can repeat a position of this line, it can score at least a draw
+    if (board.hasUpcomingRepetition(ply)) {
+        if (board.getTurn() == Player::WHITE) {
+            if (0 > beta) {
+                return 0;
+            }
+            alpha = std::max(alpha, 0);
+        }
+        else {
+            if (0 < alpha) {
+                return 0;
+            }
+            beta = std::min(beta, 0);
+        }
+    }
+
+    // solved endgames are looked up instead of searched
+    int tbValue;
+    if (tablebases.getCardinality() > 0 && (int)__popcnt64(board.getAllPieces()) <= tablebases.getCardinality() &&
+        tablebases.probe(board, tbValue)) {
+        STATS_INC(stats, tbHits);
+        return tablebaseScore(tbValue);
+    }
+
+    if (depth == 0 || ply >= MAX_PLY - 1) {
+        return quiescence(ply, alpha, beta);
+    }
+
+    // an exclusion search (see singular extensions below) is a different search of the same position,
+    // so it's stored under its own key instead of using or overwriting the entry of the full search
+    Move excluded = excludedMove[ply];
+    bool excluding = excluded.from != Square::SQUARE_NONE;
+    uint64_t key = excluding ? board.getHash() ^ exclusionKey(excluded) : board.getHash();
+
+    // a result stored from an earlier search that is at least as deep can be used directly
+    Move ttMove = { Square::SQUARE_NONE, Square::SQUARE_NONE };
+    TTEntry entry;
+    int ttScore = 0;
+    STATS_INC(stats, ttProbes);
+    bool ttHit;
+    {
+        Profiler::ScopedTimer ttTimer(ProfileStage::TT_PROBE);
+        ttHit = tt.probe(key, entry);
+    }
+    if (ttHit) {
+        STATS_INC(stats, ttHits);
+        ttMove = TranspositionTable::unpackMove(entry.move);
+        ttScore = scoreFromTT(entry.score, ply);
+        if (entry.depth >= depth && (entry.bound == BOUND_EXACT ||
+            (entry.bound == BOUND_LOWER && ttScore > beta) ||
+            (entry.bound == BOUND_UPPER && ttScore < alpha))) {
+            STATS_INC(stats, ttCutoffs);
+            return ttScore;
+        }
+    }
+
+    // without a move from the table the first move searched is only a guess, so the node is searched a ply
+    // shallower (internal iterative reduction). Its result is stored, so the next iteration has a move to start with
+    if (ttMove.from == Square::SQUARE_NONE && depth >= IIR_MIN_DEPTH && !excluding) {
+        STATS_INC(stats, iirReductions);
+        depth--;
     }
 
     std::vector<Move> moves = generateSortedMoves();
     if (moves.size() == 0) {
         if (board.isChecked(board.getTurn())) {
             if (board.getTurn() == Player::WHITE) {
-                return BLACK_CHECKMATE;
+                return BLACK_CHECKMATE + ply;
             }
-            return WHITE_CHECKMATE;
+            return WHITE_CHECKMATE - ply;
         }
         return 0;
     }
 
+    if (excluding) {
+        moves.erase(std::remove_if(moves.begin(), moves.end(), [&](Move& m) {
+            return m.from == excluded.from && m.to == excluded.to && m.promotion == excluded.promotion;
+        }), moves.end());
+        if (moves.empty()) {
+            return board.getTurn() == Player::WHITE ? alpha : beta; // no alternative, so the excluded move is singular
+        }
+    }
+
+    // the best move of an earlier search is likely still the best, so search it first
+    bool ttMoveFirst = false;
+    for (int i = 0; i < (int)moves.size(); i++) {
+        if (moves[i].from == ttMove.from && moves[i].to == ttMove.to && moves[i].promotion == ttMove.promotion) {
+            std::rotate(moves.begin(), moves.begin() + i, moves.begin() + i + 1);
+            ttMoveFirst = true;
+            break;
+        }
+    }
+
+    // singular extension: when the table's move scores at least a margin above every other move (searched
+    // at reduced depth without it), the line depends on that one move, so it is searched a ply deeper.
+    // If instead another move also beats beta, two moves cut, so the node is cut right away (multi-cut)
+    bool white = board.getTurn() == Player::WHITE;
+    bool singular = false;
+    if (ttMoveFirst && !excluding && depth >= SINGULAR_MIN_DEPTH && entry.depth >= depth - 3 &&
+        std::abs(ttScore) < MATE_BOUND &&
+        (entry.bound == BOUND_EXACT || entry.bound == (white ? BOUND_LOWER : BOUND_UPPER))) {
+        int singularBeta = white ? ttScore - SINGULAR_MARGIN * depth : ttScore + SINGULAR_MARGIN * depth;
+        excludedMove[ply] = ttMove;
+        int value = white ? evalAtDepth((depth - 1) / 2, ply, singularBeta - 2, singularBeta - 1) :
+            evalAtDepth((depth - 1) / 2, ply, singularBeta + 1, singularBeta + 2);
+        excludedMove[ply] = { Square::SQUARE_NONE, Square::SQUARE_NONE };
+        if (searchAborted) {
+            return 0;
+        }
+
+        if (white ? value < singularBeta : value > singularBeta) {
+            STATS_INC(stats, singularExtensions);
+            singular = true;
+        }
+        else if (white ? singularBeta > beta : singularBeta < alpha) {
+            STATS_INC(stats, multiCuts);
+            return singularBeta;
+        }
+    }
+
+    int originalAlpha = alpha;
+    int originalBeta = beta;
     int best = board.getTurn() == Player::WHITE ? INT_MIN : INT_MAX; // initialize to worst case
+    Move bestMove = moves[0];
+    TTBound bound = BOUND_EXACT;
     int numMovesTested = 0;
+
+    // the singular move and checks are searched one ply deeper so that forcing lines aren't cut off
+    // before the reply. Past twice the iteration's depth nothing is extended, or a long run of checks
+    // (ex: a perpetual) would keep the line from ever reaching quiescence
+    bool canExtend = ply < 2 * rootDepth;
     for (Move& move : moves) {
-        MoveUndoInfo moveInfo = board.makeMove(move);
-        int eval = evalAtDepth(depth - 1, alpha, beta);
-        if (board.getTurn() == Player::BLACK) { // white just moved
+        int extension = 0;
+        if (canExtend && singular && &move == &moves[0]) {
+            extension = 1;
+        }
+        else if (canExtend && board.givesCheck(move)) {
+            STATS_INC(stats, checkExtensions);
+            extension = 1;
+        }
+        MoveUndoInfo moveInfo = makeMove(move, depth - 1 + extension > 0);
+        int eval = evalAtDepth(depth - 1 + extension, ply + 1, alpha, beta);
+        undoMove(moveInfo);
+        if (searchAborted) {
+            return 0;
+        }
+
+        bool improved = board.getTurn() == Player::WHITE ? eval > best : eval < best;
+        if (improved) {
+            best = eval;
+            bestMove = move;
+            pv[ply][ply] = move;
+            for (int i = ply + 1; i < pvLength[ply + 1]; i++) {
+                pv[ply][i] = pv[ply + 1][i];
+            }
+            pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+        }
+
+        if (board.getTurn() == Player::WHITE) {
             // we want to maximize eval function
-            best = best > eval ? best : eval;
             if (best > beta) {
-                board.undoMove(moveInfo);
-                return best;
+                bound = BOUND_LOWER;
+                break;
             }
             alpha = best > alpha ? best : alpha;
         }
-        else { // black just moved
+        else {
             // we want to minimize eval function
-            best = best < eval ? best : eval;
             if (best < alpha) {
-                board.undoMove(moveInfo);
-                return best;
+                bound = BOUND_UPPER;
+                break;
             }
             beta = best < beta ? best : beta;
         }
+        numMovesTested++;
+    }
+
+    if (bound != BOUND_EXACT) {
+        STATS_INC(stats, betaCutoffs);
+        if (numMovesTested == 0) {
+            STATS_INC(stats, firstMoveCutoffs);
+        }
+    }
+    else if (board.getTurn() == Player::WHITE && best <= originalAlpha) {
+        bound = BOUND_UPPER; // no move reached alpha
+    }
+    else if (board.getTurn() == Player::BLACK && best >= originalBeta) {
+        bound = BOUND_LOWER; // no move got below beta
+    }
+    {
+        Profiler::ScopedTimer ttTimer(ProfileStage::TT_PROBE);
+        tt.store(key, depth, scoreToTT(best, ply), bound, bestMove);
+    }
+
+    return best;
+}
+
+int ChessEngine::scoreToTT(int score, int ply) {
+    if (score > MATE_BOUND) {
+        return score + ply;
+    }
+    if (score < -MATE_BOUND) {
+        return score - ply;
+    }
+    return score;
+}
+
+int ChessEngine::scoreFromTT(int score, int ply) {
+    if (score > MATE_BOUND) {
+        return score - ply;
+    }
+    if (score < -MATE_BOUND) {
+        return score + ply;
+    }
+    return score;
+}
+
+std::vector<Move> ChessEngine::getPrincipalVariation() {
+    return lines.empty() ? std::vector<Move>() : lines[0].moves;
+}
+
+bool ChessEngine::getPonderMove(Move bestMove, Move& outPonderMove) {
+    std::vector<Move> bestLine = getPrincipalVariation();
+    if (bestLine.size() >= 2 && bestLine[0].from == bestMove.from && bestLine[0].to == bestMove.to) {
+        outPonderMove = bestLine[1];
+        return true;
+    }
+
+    // the line may have been cut short by a transposition table cutoff, so look up the reply instead
+    MoveUndoInfo moveInfo = board.makeMove(bestMove);
+    TTEntry entry;
+    bool found = false;
+    if (tt.probe(board.getHash(), entry)) {
+        Move reply = TranspositionTable::unpackMove(entry.move);
+        for (Move& m : board.generateAllLegalMoves()) {
+            if (m.from == reply.from && m.to == reply.to && m.promotion == reply.promotion) {
+                outPonderMove = m;
+                found = true;
+                break;
+            }
+        }
+    }
+    board.undoMove(moveInfo);
+    return found;
+}
+
+void ChessEngine::extendLineFromTT(std::vector<Move>& line, int maxLength) {
+    std::vector<MoveUndoInfo> undoInfo;
+    for (Move& m : line) {
+        undoInfo.push_back(board.makeMove(m));
+    }
+
+    TTEntry entry;
+    while ((int)line.size() < maxLength && tt.probe(board.getHash(), entry)) {
+        Move stored = TranspositionTable::unpackMove(entry.move);
+        bool legal = false;
+        for (Move& m : board.generateAllLegalMoves()) {
+            if (m.from == stored.from && m.to == stored.to && m.promotion == stored.promotion) {
+                line.push_back(m);
+                undoInfo.push_back(board.makeMove(m));
+                legal = true;
+                break;
+            }
+        }
+        if (!legal) {
+            break;
+        }
+    }
+
+    while (!undoInfo.empty()) {
+        board.undoMove(undoInfo.back());
+        undoInfo.pop_back();
+    }
+}
+
+std::string ChessEngine::toUCIScore(int eval) {
+    int score = board.getTurn() == Player::WHITE ? eval : -eval;
+    if (score > MATE_BOUND) {
+        return "mate " + std::to_string((WHITE_CHECKMATE - score + 1) / 2);
+    }
+    if (score < -MATE_BOUND) {
+        return "mate -" + std::to_string((WHITE_CHECKMATE + score) / 2);
+    }
+    return "cp " + std::to_string(score);
+}
+
+int64_t ChessEngine::elapsedTime() {
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    return now - searchStartTime;
+}
+
+void ChessEngine::checkTime() {
+    if (stopRequested || (timeBudget > 0 && !pondering && elapsedTime() >= timeBudget)) {
+        searchAborted = true;
+    }
+}
+
+int64_t ChessEngine::computeTimeBudget(const SearchLimits& limits) {
+    if (limits.moveTime > 0) {
+        return limits.moveTime;
+    }
+    int64_t time = board.getTurn() == Player::WHITE ? limits.whiteTime : limits.blackTime;
+    int64_t increment = board.getTurn() == Player::WHITE ? limits.whiteIncrement : limits.blackIncrement;
+    if (time <= 0) {
+        return 0;
+    }
+
+    // spread the remaining time over the moves left (assume 30 if unknown), keeping a margin for communication
+    int movesToGo = limits.movesToGo > 0 ? limits.movesToGo : 30;
+    int64_t budget = time / movesToGo + increment * 3 / 4;
+    return std::max<int64_t>(1, std::min(budget, time - 50));
+}
+
+void ChessEngine::runSearch(SearchLimits limits) {
+    // the same node as the thread that clears the table, or the first slice of a table cleared in parallel
+    Memory::bindThread(0);
+    Profiler::reset();
+    Move m = iterativeDeepening(limits, true);
+
+    // the best move of a ponder or infinite search may only be sent after "ponderhit" or "stop"
+    while (!stopRequested && (pondering || limits.infinite)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    reportStats();
+    reportProfile();
+    Move ponderMove;
+    if (m.from != Square::SQUARE_NONE && getPonderMove(m, ponderMove)) {
+        print("bestmove " + Moves::toString(m) + " ponder " + Moves::toString(ponderMove));
+    }
+    else {
+        print("bestmove " + (m.from == Square::SQUARE_NONE ? std::string("0000") : Moves::toString(m)));
+    }
+}
+
+void ChessEngine::stopSearchThread() {
+    if (searchThread.joinable()) {
+        stopRequested = true;
+        searchThread.join();
+    }
+}
+
+int ChessEngine::tablebaseScore(int value) {
+    int score = 0;
+    if (Tablebases::isWin(value)) {
+        score = TABLEBASE_WIN - Tablebases::getDistance(value);
+    }
+    else if (Tablebases::isLoss(value)) {
+        score = -(TABLEBASE_WIN - Tablebases::getDistance(value));
+    }
+    return board.getTurn() == Player::WHITE ? score : -score;
+}
+
+void ChessEngine::filterTablebaseMoves(std::vector<Move>& moves) {
+    int rootValue;
+    if (!tablebases.probe(board, rootValue)) {
+        return;
+    }
+
+    // rank each move by the result it keeps for us: faster wins and slower losses rank higher
+    std::vector<int> ranks;
+    int bestRank = INT_MIN;
+    for (Move& move : moves) {
+        MoveUndoInfo moveInfo = board.makeMove(move);
+        int childValue;
+        bool found = tablebases.probe(board, childValue);
         board.undoMove(moveInfo);
+        if (!found) {
+            return;
+        }
+
+        // the child's value is from the opponent's perspective
+        int rank = 0;
+        if (Tablebases::isLoss(childValue)) {
+            rank = 1000 - Tablebases::getDistance(childValue);
+        }
+        else if (Tablebases::isWin(childValue)) {
+            rank = -1000 + Tablebases::getDistance(childValue);
+        }
+        ranks.push_back(rank);
+        bestRank = std::max(bestRank, rank);
     }
 
+    std::vector<Move> bestMoves;
+    for (int i = 0; i < (int)moves.size(); i++) {
+        if (ranks[i] == bestRank) {
+            bestMoves.push_back(moves[i]);
+        }
+    }
+    moves = bestMoves;
+}
+
+MoveUndoInfo ChessEngine::makeMove(Move m, bool prefetchTT) {
+    Profiler::ScopedTimer timer(ProfileStage::MAKE_UNMAKE);
+    return board.makeMove(m, prefetchTT ? &tt : nullptr);
+}
+
+void ChessEngine::undoMove(MoveUndoInfo m) {
+    Profiler::ScopedTimer timer(ProfileStage::MAKE_UNMAKE);
+    board.undoMove(m);
+}
+
+int ChessEngine::quiescence(int ply, int alpha, int beta) {
+    stats.nodes++;
+    STATS_INC(stats, qnodes);
+    STATS_INC_PLY(stats, ply);
+    pvLength[ply] = ply;
+
+    if ((stats.nodes & 1023) == 0) {
+        checkTime();
+    }
+    if (searchAborted) {
+        return 0;
+    }
+
+    bool white = board.getTurn() == Player::WHITE;
+    bool inCheck = board.isChecked(board.getTurn());
+    if (ply >= MAX_PLY - 1) {
+        return evaluate();
+    }
+
+    std::vector<Move> moves;
+    std::vector<int> exchanges;
+    int best = white ? INT_MIN : INT_MAX;
+    if (inCheck) {
+        moves = generateSortedMoves();
+        if (moves.empty()) {
+            return white ? BLACK_CHECKMATE + ply : WHITE_CHECKMATE - ply;
+        }
+    }
+    else {
+        // standing pat: the side to move doesn't have to capture
+        best = evaluate();
+        if (white ? best > beta : best < alpha) {
+            return best;
+        }
+        if (white) {
+            alpha = std::max(alpha, best);
+        }
+        else {
+            beta = std::min(beta, best);
+        }
+
+        // losing captures are pruned, the rest are searched most winning first
+        for (Move& m : board.generatePseudolegalMoves(GEN_CAPTURES)) {
+            int exchange = board.see(m);
+            if (exchange < 0 || !board.isLegal(m)) {
+                continue;
+            }
+            int i = (int)moves.size();
+            moves.push_back(m);
+            exchanges.push_back(exchange);
+            for (; i > 0 && exchanges[i - 1] < exchange; i--) {
+                std::swap(moves[i], moves[i - 1]);
+                std::swap(exchanges[i], exchanges[i - 1]);
+            }
+        }
+    }
+
+    for (Move& move : moves) {
+        MoveUndoInfo moveInfo = makeMove(move, false);
+        int eval = quiescence(ply + 1, alpha, beta);
+        undoMove(moveInfo);
+        if (searchAborted) {
+            return 0;
+        }
+
+        if (white) {
+            best = std::max(best, eval);
+            if (best > beta) {
+                break;
+            }
+            alpha = std::max(alpha, best);
+        }
+        else {
+            best = std::min(best, eval);
+            if (best < alpha) {
+                break;
+            }
+            beta = std::min(beta, best);
+        }
+    }
     return best;
 }
 
 std::vector<Move> ChessEngine::generateSortedMoves() {
-    std::vector<Move> moves = board.generateAllLegalMoves();
-    std::sort(moves.begin(), moves.end(), 
-        [this](Move& m1, Move& m2) {
-            return predictMoveScore(m1) < predictMoveScore(m2);
+    Profiler::ScopedTimer timer(ProfileStage::MOVE_PICKER);
+    std::vector<Move> moves;
+    {
+        Profiler::ScopedTimer movegenTimer(ProfileStage::MOVE_GENERATION);
+        moves = board.generateAllLegalMoves();
+    }
+
+    // score each move once, then insertion sort from best to worst since move lists are short
+    std::vector<int> scores(moves.size());
+    for (int i = 0; i < (int)moves.size(); i++) {
+        scores[i] = predictMoveScore(moves[i]);
+    }
+    for (int i = 1; i < (int)moves.size(); i++) {
+        Move move = moves[i];
+        int score = scores[i];
+        int j = i;
+        for (; j > 0 && scores[j - 1] < score; j--) {
+            moves[j] = moves[j - 1];
+            scores[j] = scores[j - 1];
         }
-    );
+        moves[j] = move;
+        scores[j] = score;
+    }
     return moves;
 }
 
@@ -121,9 +896,11 @@ int ChessEngine::predictMoveScore(Move m) {
     Piece fromPiece = board.getPieceTypeAtSquareGivenColor(m.from, board.getTurn());
     Piece toPiece = board.getPieceTypeAtSquareGivenColor(m.to, Players::getEnemy(board.getTurn()));
 
-    // prioritize capturing high value pieces with low value pieces
+    // prioritize capturing high value pieces with low value pieces, unless the exchange loses material.
+    // Losing captures go after the quiet moves
     if (toPiece != Piece::PIECE_NONE) {
-        score += 10 * pieceValues[toPiece] - pieceValues[fromPiece]; 
+        int exchange = board.see(m);
+        score += exchange >= 0 ? 10 * pieceValues[toPiece] - pieceValues[fromPiece] : exchange;
     }
 
     // incentivize pawn promotion
@@ -131,13 +908,34 @@ int ChessEngine::predictMoveScore(Move m) {
         score += pieceValues[m.promotion];
     }
 
+    // checks are forcing, so try them before other quiet moves
+    if (toPiece == Piece::PIECE_NONE && m.promotion == Piece::PIECE_NONE && board.givesCheck(m)) {
+        score += CHECK_ORDER_BONUS;
+    }
+
     return score;
 }
 
+bool ChessEngine::parseMove(const std::string& text, Move& outMove) {
+    Move parsed;
+    if (!Moves::fromString(text, parsed)) {
+        return false;
+    }
+    for (Move& m : board.generateAllLegalMoves()) {
+        if (m.from == parsed.from && m.to == parsed.to && m.promotion == parsed.promotion) {
+            outMove = m;
+            return true;
+        }
+    }
+    return false;
+}
+
 void ChessEngine::startUCI() {
     while (true) {
         std::string command;
-        std::getline(std::cin, command);
+        if (!std::getline(std::cin, command)) {
+            command = "quit"; // input was closed
+        }
         std::stringstream commandStream(command);
         std::string token;
         std::vector<std::string> tokens;
@@ -145,18 +943,29 @@ void ChessEngine::startUCI() {
             tokens.push_back(token);
         }
 
-        processUCICommand(tokens);
+        if (!tokens.empty()) {
+            processUCICommand(tokens);
+        }
     }
 }
 
-void print(std::string s) {
-    std::cout << s.c_str() << std::endl;
-}
-
 void ChessEngine::processUCICommand(std::vector<std::string>& tokens) {
     if (tokens[0] == "uci") {
         print("id name SuperCoolEngine");
         print("id author Uzair Nawaz");
+        print("option name Hash type spin default " + std::to_string(TranspositionTable::DEFAULT_SIZE_MB) + " min 1 max " + std::to_string(MAX_HASH_MB));
+        print("option name LargePages type check default true");
+        print("option name HashFile type string default <empty>");
+        print("option name SaveHashToFile type button");
+        print("option name LoadHashFromFile type button");
+        print("option name Ponder type check default false");
+        print("option name MultiPV type spin default 1 min 1 max " + std::to_string(MAX_MULTI_PV));
+        print("option name StatsFile type string default <empty>");
+        print("option name Profile type check default false");
+        print("option name ProfileFile type string default <empty>");
+        print("option name TablebasePath type string default <empty>");
+        print("option name OwnBook type check default false");
+        print("option name BookFile type string default <empty>");
 
         print("uciok");
     }
@@ -167,110 +976,237 @@ void ChessEngine::processUCICommand(std::vector<std::string>& tokens) {
         print("readyok");
     }
     else if (tokens[0] == "setoption") {
-
+        stopSearchThread();
+        setOption(tokens);
     }
     else if (tokens[0] == "register") {
 
     }
     else if (tokens[0] == "ucinewgame") {
+        stopSearchThread();
         board = Chessboard();
+        tt.clear();
+        positionBase.clear();
+        positionMoves.clear();
     }
     else if (tokens[0] == "position") {
-        int movesToken = 0;
-        for (int i = 0; i < tokens.size(); i++) {
+        stopSearchThread();
+        int movesToken = (int)tokens.size();
+        for (int i = 0; i < (int)tokens.size(); i++) {
             if (tokens[i] == "moves") {
                 movesToken = i;
                 break;
             }
         }
 
-        if (tokens[1] == "startpos") {
-            board = Chessboard();
-        }
-        else if (tokens[1] == "fen") {
-            std::string fen = "";
-            int fenEnd = movesToken == 0 ? tokens.size() : movesToken;
-            for (int i = 1; i < fenEnd; i++) {
-                fen += tokens[i];
-            }
-            board = Chessboard(fen);
-        }
-
-        if (movesToken != 0) {
-            for (int i = movesToken + 1; i < tokens.size(); i++) {
-                Move m = { Squares::fromAlgebraic(tokens[i].substr(0, 2).c_str()), Squares::fromAlgebraic(tokens[i].substr(2, 2).c_str()) };
-                if (tokens[i].size() == 5) {
-                    switch (tokens[i][5]) {
-                    case 'p':
-                        m.promotion = Piece::PAWN;
-                        break;
-                    case 'n':
-                        m.promotion = Piece::KNIGHT;
-                        break;
-                    case 'b':
-                        m.promotion = Piece::BISHOP;
-                        break;
-                    case 'r':
-                        m.promotion = Piece::ROOK;
-                        break;
-                    case 'q':
-                        m.promotion = Piece::QUEEN;
-                        break;
-                    }
-                }
-                board.makeMove(m);
+        std::string base = "startpos";
+        if (tokens.size() > 1 && tokens[1] == "fen") {
+            base = "";
+            for (int i = 2; i < movesToken; i++) {
+                base += (base.empty() ? "" : " ") + tokens[i];
             }
         }
 
+        // a GUI sends the whole game every move, so if it extends the previous position only the new moves are applied
+        int numMoves = std::max((int)tokens.size() - movesToken - 1, 0);
+        bool extendsPrevious = base == positionBase && numMoves >= (int)positionMoves.size();
+        for (int i = 0; extendsPrevious && i < (int)positionMoves.size(); i++) {
+            Move m;
+            extendsPrevious = Moves::fromString(tokens[movesToken + 1 + i], m) &&
+                m.from == positionMoves[i].from && m.to == positionMoves[i].to && m.promotion == positionMoves[i].promotion;
+        }
+        if (!extendsPrevious) {
+            board = base == "startpos" ? Chessboard() : Chessboard(base);
+            positionBase = base;
+            positionMoves.clear();
+        }
+
+        for (int i = (int)positionMoves.size(); i < numMoves; i++) {
+            Move m;
+            if (!parseMove(tokens[movesToken + 1 + i], m)) {
+                print("info string illegal move " + tokens[movesToken + 1 + i]);
+                break;
+            }
+            board.makeMove(m);
+            positionMoves.push_back(m);
+        }
     }
     else if (tokens[0] == "go") {
-        Move m = search(5);
-        print("bestmove " + Moves::toString(m));
-        if (tokens[1] == "searchmoves") {
+        stopSearchThread();
 
+        SearchLimits limits;
+        for (int i = 1; i < (int)tokens.size(); i++) {
+            bool hasValue = i + 1 < (int)tokens.size();
+            if (tokens[i] == "ponder") {
+                limits.ponder = true;
+            }
+            else if (tokens[i] == "infinite") {
+                limits.infinite = true;
+            }
+            else if (tokens[i] == "wtime" && hasValue) {
+                parseNumber<int64_t>(tokens[++i], 0, MAX_GO_TIME, limits.whiteTime);
+            }
+            else if (tokens[i] == "btime" && hasValue) {
+                parseNumber<int64_t>(tokens[++i], 0, MAX_GO_TIME, limits.blackTime);
+            }
+            else if (tokens[i] == "winc" && hasValue) {
+                parseNumber<int64_t>(tokens[++i], 0, MAX_GO_TIME, limits.whiteIncrement);
+            }
+            else if (tokens[i] == "binc" && hasValue) {
+                parseNumber<int64_t>(tokens[++i], 0, MAX_GO_TIME, limits.blackIncrement);
+            }
+            else if (tokens[i] == "movestogo" && hasValue) {
+                parseNumber(tokens[++i], 0, INT_MAX, limits.movesToGo);
+            }
+            else if (tokens[i] == "depth" && hasValue) {
+                parseNumber(tokens[++i], 1, MAX_PLY - 1, limits.depth);
+            }
+            else if (tokens[i] == "movetime" && hasValue) {
+                parseNumber<int64_t>(tokens[++i], 0, MAX_GO_TIME, limits.moveTime);
+            }
+            else if (tokens[i] == "mate" && hasValue) {
+                parseNumber(tokens[++i], 1, MAX_PLY / 2, limits.mate);
+            }
+            else if (tokens[i] == "searchmoves") {
+                // the move list ends at the next token that isn't a legal move
+                Move m;
+                while (i + 1 < (int)tokens.size() && parseMove(tokens[i + 1], m)) {
+                    limits.searchMoves.push_back(m);
+                    i++;
+                }
+            }
         }
-        else if (tokens[1] == "ponder") {
 
+        // the book answers instantly, but a ponder search must wait for ponderhit so it always searches
+        Move bookMove;
+        if (!limits.ponder && ownBook && book.pickMove(board, rng, bookMove)) {
+            print("bestmove " + Moves::toString(bookMove));
+            return;
         }
-        else if (tokens[1] == "wtime") {
 
+        timeBudget = computeTimeBudget(limits);
+        if (limits.depth == 0 && timeBudget == 0 && !limits.infinite && !limits.ponder) {
+            limits.depth = DEFAULT_DEPTH;
         }
-        else if (tokens[1] == "btime") {
+        searchStartTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        stopRequested = false;
+        pondering = limits.ponder;
+        searchThread = std::thread(&ChessEngine::runSearch, this, limits);
+    }
+    else if (tokens[0] == "stop") {
+        stopSearchThread();
+    }
+    else if (tokens[0] == "ponderhit") {
+        // the opponent played the expected move, so the ponder search becomes a normal timed search
+        searchStartTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        pondering = false;
+    }
+    else if (tokens[0] == "quit") {
+        stopSearchThread();
+        exit(1);
+    }
+}
 
-        }
-        else if (tokens[1] == "winc") {
 
+void ChessEngine::setOption(std::vector<std::string>& tokens) {
+    // option names and values may contain spaces, so join all tokens between the keywords
+    std::string name = "";
+    std::string value = "";
+    std::string* current = nullptr;
+    for (size_t i = 1; i < tokens.size(); i++) {
+        if (tokens[i] == "name") {
+            current = &name;
         }
-        else if (tokens[1] == "binc") {
-
+        else if (tokens[i] == "value") {
+            current = &value;
         }
-        else if (tokens[1] == "movestogo") {
-
+        else if (current != nullptr) {
+            *current += (current->empty() ? "" : " ") + tokens[i];
         }
-        else if (tokens[1] == "depth") {
+    }
 
+    if (name == "StatsFile") {
+        statsFile = value == "<empty>" ? "" : value;
+    }
+    else if (name == "Profile") {
+        Profiler::enabled = value == "true";
+    }
+    else if (name == "ProfileFile") {
+        profileFile = value == "<empty>" ? "" : value;
+    }
+    else if (name == "Hash") {
+        int sizeMB;
+        if (parseNumber(value, 1, MAX_HASH_MB, sizeMB)) {
+            tt.resize(sizeMB);
         }
-        else if (tokens[1] == "nodes") {
-
+    }
+    else if (name == "HashFile") {
+        hashFile = value == "<empty>" ? "" : value;
+    }
+    else if (name == "SaveHashToFile" || name == "LoadHashFromFile") {
+        bool saving = name == "SaveHashToFile";
+        auto start = std::chrono::steady_clock::now();
+        bool ok = !hashFile.empty() && (saving ? tt.save(hashFile) : tt.load(hashFile));
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if (ok) {
+            print(std::string("info string ") + (saving ? "saved " : "loaded ") + std::to_string(tt.sizeMB()) +
+                " MB hash " + (saving ? "to " : "from ") + hashFile + " in " + std::to_string(elapsed) + " ms");
         }
-        else if (tokens[1] == "mate") {
-
+        else {
+            print(std::string("info string could not ") + (saving ? "save hash to " : "load hash from ") +
+                (hashFile.empty() ? "<empty>, set HashFile first" : hashFile));
         }
-        else if (tokens[1] == "movetime") {
-
+    }
+    else if (name == "LargePages") {
+        tt.setLargePages(value == "true");
+        print(std::string("info string transposition table ") + (tt.usesLargePages() ? "uses" : "does not use") + " large pages");
+    }
+    else if (name == "MultiPV") {
+        int numLines;
+        if (parseNumber(value, 1, MAX_MULTI_PV, numLines)) {
+            setMultiPV(numLines);
         }
-        else if (tokens[1] == "infinite") {
-
+    }
+    else if (name == "OwnBook") {
+        ownBook = value == "true";
+    }
+    else if (name == "BookFile") {
+        if (value == "<empty>" || value.empty()) {
+            book.close();
+        }
+        else if (book.open(value)) {
+            print("info string loaded book with " + std::to_string(book.size()) + " entries");
+        }
+        else {
+            print("info string could not open book " + value);
         }
     }
-    else if (tokens[0] == "stop") {
-
+    else if (name == "TablebasePath") {
+        int numLoaded = tablebases.load(value);
+        print("info string loaded " + std::to_string(numLoaded) + " tablebases");
     }
-    else if (tokens[0] == "ponderhit") {
+}
 
+void ChessEngine::reportStats() {
+#ifdef SEARCH_STATS
+    if (debug) {
+        print(stats.toInfoString());
     }
-    else if (tokens[0] == "quit") {
-        exit(1);
+    if (!statsFile.empty()) {
+        std::ofstream out(statsFile, std::ios::app);
+        out << stats.toJSON() << std::endl;
     }
+#endif
 }
 
+void ChessEngine::reportProfile() {
+    if (!Profiler::enabled) {
+        return;
+    }
+    print(Profiler::stageBreakdown());
+    if (!profileFile.empty()) {
+        Profiler::writeChromeTrace(profileFile);
+    }
+}
@@ -1,9 +1,43 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <random>
+#include <thread>
 
 #include "Chessboard.h"
+#include "OpeningBook.h"
+#include "Profiler.h"
+#include "SearchStats.h"
+#include "Tablebase.h"
+#include "TranspositionTable.h"
+
+/***
+ * Limits of a search, parsed from the arguments of the UCI "go" command.
+ * Times are in milliseconds, and 0 means the limit wasn't given.
+ */
+struct SearchLimits {
+    int depth = 0;
+    int64_t moveTime = 0;
+    int64_t whiteTime = 0;
+    int64_t blackTime = 0;
+    int64_t whiteIncrement = 0;
+    int64_t blackIncrement = 0;
+    int movesToGo = 0;
+    bool infinite = false;
+    bool ponder = false;
+    int mate = 0;                // look for a mate in at most this many moves
+    std::vector<Move> searchMoves; // if not empty, only these root moves are searched
+};
+
+/***
+ * One of the best lines found at the root of a search: its evaluation (positive: white winning)
+ * and principal variation, starting with the root move
+ */
+struct SearchLine {
+    int eval;
+    std::vector<Move> moves;
+};
 
 class ChessEngine
 {
@@ -12,24 +46,233 @@ private:
 
     bool debug = false;
 
+    // statistics for the most recent search, only collected when SEARCH_STATS is defined
+    SearchStats stats;
+
+    // if set, a JSON line containing the stats of every search is appended to this file
+    std::string statsFile;
+
+    // if set, a Chrome trace of the last search is written to this file while profiling
+    std::string profileFile;
+
+    // file the transposition table is saved to and loaded from by the SaveHashToFile/LoadHashFromFile options
+    std::string hashFile;
+
+    // evaluation of the best move found by the most recent search
+    int lastEval = 0;
+
     static const int WHITE_CHECKMATE = INT_MAX / 2;
     static const int BLACK_CHECKMATE = -(INT_MAX / 2);
 
+    // checkmates found by search score WHITE_CHECKMATE - ply (or BLACK_CHECKMATE + ply), so faster mates score higher.
+    // any score beyond MATE_BOUND is a mate
+    static const int MAX_PLY = 64;
+    static const int MATE_BOUND = WHITE_CHECKMATE - MAX_PLY;
+
+    // depth searched when "go" is given no limits
+    static const int DEFAULT_DEPTH = 5;
+
+    TranspositionTable tt;
+    static constexpr int MAX_HASH_MB = 4096;
+
+    // position set by the last "position" command ("startpos" or a FEN) and the moves played from it
+    std::string positionBase;
+    std::vector<Move> positionMoves;
+
+    // triangular principal variation table: pv[ply][ply..pvLength[ply]) is the best line found from ply
+    Move pv[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+
+    // depth of the current iteration. Lines are only extended up to twice this many plies
+    int rootDepth = 0;
+
+    // move skipped by the search at each ply, SQUARE_NONE if none (set during singular extension searches)
+    Move excludedMove[MAX_PLY];
+
+    // number of best root moves to search and report (UCI MultiPV)
+    int multiPV = 1;
+    static constexpr int MAX_MULTI_PV = 64;
+
+    // best lines of the deepest completed iteration, best first
+    std::vector<SearchLine> lines;
+
+    /*
+     * In UCI mode the search runs on its own thread so that commands like "stop" and "ponderhit"
+     * are read while searching. The search checks these flags periodically.
+     */
+    std::thread searchThread;
+    std::atomic<bool> stopRequested{ false };
+    std::atomic<bool> pondering{ false };
+    std::atomic<int64_t> searchStartTime{ 0 }; // reset on ponderhit, since the clock only starts then
+    int64_t timeBudget = 0;                    // time the current search may use, 0 if unlimited
+    bool searchAborted = false;
+
+    // score of a tablebase win, lower than a checkmate found by search
+    static const int TABLEBASE_WIN = WHITE_CHECKMATE / 2;
+
     static const int pieceValues[];
 
+    // nodes at least this deep are searched a ply shallower when the table has no move for them
+    static const int IIR_MIN_DEPTH = 4;
+
+    // nodes at least this deep try to extend a singular table move. It's singular if every other move
+    // scores at least SINGULAR_MARGIN * depth worse
+    static const int SINGULAR_MIN_DEPTH = 8;
+    static const int SINGULAR_MARGIN = 2;
+
+    // ordering bonus of a quiet move that gives check, placing it ahead of other quiet moves but behind most captures
+    static const int CHECK_ORDER_BONUS = 500;
+
+    Tablebases tablebases;
+
+    // if ownBook is set, moves in the book are played without searching
+    OpeningBook book;
+    bool ownBook = false;
+
+    /***
+     * Converts a tablebase value (relative to the side to move) to a score (positive: white winning)
+     */
+    int tablebaseScore(int value);
+
+    /***
+     * If the position is in the tablebases, removes every root move that doesn't keep the best
+     * possible result with the shortest mate (or longest resistance when losing)
+     */
+    void filterTablebaseMoves(std::vector<Move>& moves);
+
     /***
      * Perform alpha beta pruning to evaluate a position to a certain depth.
      * 
+     * Ply - distance from the root of the search
      * Alpha - best explored evaluation for white
      * Beta - best explored evaluation for black
      */
-    int evalAtDepth(int depth, int alpha, int beta);
+    int evalAtDepth(int depth, int ply, int alpha, int beta);
+
+    /***
+     * Searches captures (and promotions) at the end of the main search until the position is quiet, so the
+     * evaluation isn't taken in the middle of an exchange. The side to move can always stop capturing
+     * (stand pat), and captures that lose material by static exchange evaluation are skipped.
+     * In check, every evasion is searched instead.
+     */
+    int quiescence(int ply, int alpha, int beta);
+
+    /***
+     * Searches the root moves from firstMove on to a certain depth, moving the best one to moves[firstMove].
+     * Moves before firstMove are excluded, which is how MultiPV finds the next best line.
+     * Returns the evaluation of the best move.
+     */
+    int searchRoot(int depth, std::vector<Move>& moves, int firstMove);
+
+    /***
+     * Proves whether the side to move at ply 0 can force mate within pliesLeft plies. Every defense is
+     * searched, but with one ply left only checking moves are tried since nothing else can mate.
+     * On success the mating line is stored in the principal variation table.
+     */
+    bool mateSearch(int pliesLeft, int ply);
+
+    /***
+     * Looks for the shortest mate among the root moves in at most maxMoves moves, moving the mating
+     * move to the front of moves. Reports each proven mate through UCI info lines if report is set.
+     */
+    bool findMate(int maxMoves, std::vector<Move>& moves, bool report);
+
+    /***
+     * Searches with increasing depth until a limit is reached, reporting each completed depth
+     * through UCI info lines if report is set. Returns the best move of the deepest completed search.
+     */
+    Move iterativeDeepening(const SearchLimits& limits, bool report);
+
+    /***
+     * Runs a search started by "go" and outputs its best move once it's allowed to (ponder and
+     * infinite searches wait for "ponderhit" or "stop"). Runs on the search thread.
+     */
+    void runSearch(SearchLimits limits);
+
+    /***
+     * Signals the search thread to stop and waits for it to output its best move
+     */
+    void stopSearchThread();
+
+    /***
+     * Sets searchAborted if the search was stopped or ran out of time
+     */
+    void checkTime();
+
+    /***
+     * Returns the time to spend on a move given the clock state, or 0 if there is no time limit
+     */
+    int64_t computeTimeBudget(const SearchLimits& limits);
+
+    /***
+     * Returns the number of milliseconds since the search started
+     */
+    int64_t elapsedTime();
+
+    /***
+     * Lines cut short by a transposition table cutoff are continued with the stored best moves, up to maxLength moves
+     */
+    void extendLineFromTT(std::vector<Move>& line, int maxLength);
+
+    /***
+     * Returns the expected reply to a best move, taken from the principal variation or the transposition table.
+     * Returns false if there is none.
+     */
+    bool getPonderMove(Move bestMove, Move& outPonderMove);
+
+    /***
+     * Formats a score (positive: white winning) as a UCI score from the side to move's perspective
+     */
+    std::string toUCIScore(int eval);
+
+    /***
+     * Converts mate scores between "mate in n plies from the root" and "mate in n plies from this node",
+     * since entries in the transposition table can be reached at different plies
+     */
+    static int scoreToTT(int score, int ply);
+    static int scoreFromTT(int score, int ply);
+
+    /***
+     * Returns the value XORed into a position's hash to store a search that excludes a move
+     */
+    static uint64_t exclusionKey(Move m);
 
     /***
      * Parses UCI commands as a vector of tokens and performs appropriate actions
      */
     void processUCICommand(std::vector<std::string>& tokens);
 
+    /***
+     * Parses a move in UCI notation (ex: e2e4, e7e8q) and finds it among the legal moves of the current position.
+     * Returns false if the move isn't legal.
+     */
+    bool parseMove(const std::string& text, Move& outMove);
+
+    /***
+     * Handles a "setoption name <id> [value <x>]" command
+     */
+    void setOption(std::vector<std::string>& tokens);
+
+    /***
+     * Outputs the stats of the last search as UCI info strings (if debug is on)
+     * and to the stats file (if one is set)
+     */
+    void reportStats();
+
+    /***
+     * Outputs the per-stage time breakdown of the last search and writes its trace
+     * to the profile file (if profiling is enabled)
+     */
+    void reportProfile();
+
+    /***
+     * Performs/undoes a move on the board during search, timed by the profiler.
+     * prefetchTT should be false if the new position won't be probed in the transposition table
+     * (ex: quiescence nodes), to keep the prefetch from evicting something useful.
+     */
+    MoveUndoInfo makeMove(Move m, bool prefetchTT = true);
+    void undoMove(MoveUndoInfo m);
+
     /***
      * Returns a list of pseudolegal moves that are ordered using heuristics to try to 
      * increase performance of alpha beta pruning
@@ -49,11 +292,16 @@ public:
     Chessboard board;
 
     ChessEngine();
+    ~ChessEngine();
 
     /***
      * Load board from FEN string
      */
-    void loadFEN(std::string fen) { board = Chessboard(fen); }
+    void loadFEN(std::string fen) {
+        board = Chessboard(fen);
+        positionBase.clear();
+        positionMoves.clear();
+    }
 
     /***
      * Communicate using UCI through stdin/stdout
@@ -67,6 +315,8 @@ public:
      * 
      * Factors:
      *   - Piece values of each side
+     *   - Piece square tables
+     * Both are linear in the parameters of TunedParams.h, which are tuned by Tuner.
      */
     int evaluate();
 
@@ -74,5 +324,36 @@ public:
      * Search for the best move up to a certain depth.
      */
     Move search(int depth);
+
+    /***
+     * Search for a forced mate in at most maxMoves moves.
+     * Returns a move with from = SQUARE_NONE if there is none.
+     */
+    Move searchMate(int maxMoves);
+
+    /***
+     * Returns the principal variation of the most recent search
+     */
+    std::vector<Move> getPrincipalVariation();
+
+    /***
+     * Sets the number of lines searched and reported (the best move, the second best move, ...)
+     */
+    void setMultiPV(int numLines) { multiPV = std::max(1, std::min(numLines, MAX_MULTI_PV)); }
+
+    /***
+     * Returns the best lines of the most recent search, best first
+     */
+    const std::vector<SearchLine>& getLines() { return lines; }
+
+    /***
+     * Returns the statistics collected during the most recent search
+     */
+    const SearchStats& getStats() { return stats; }
+
+    /***
+     * Returns the evaluation of the best move found by the most recent search
+     */
+    int getLastEval() { return lastEval; }
 };
 
@@ -0,0 +1,84 @@
+
+#include <utility>
+
+#include "Chessboard.h"
+#include "Cuckoo.h"
+
+namespace Cuckoo {
+
+    static uint64_t keys[TABLE_SIZE];
+    static Square froms[TABLE_SIZE];
+    static Square tos[TABLE_SIZE];
+
+    static int hash1(uint64_t key) { return (int)(key & (TABLE_SIZE - 1)); }
+    static int hash2(uint64_t key) { return (int)((key >> 16) & (TABLE_SIZE - 1)); }
+
+    void init() {
+        for (int i = 0; i < TABLE_SIZE; i++) {
+            keys[i] = 0;
+            froms[i] = Square::SQUARE_NONE;
+            tos[i] = Square::SQUARE_NONE;
+        }
+
+        // pawn moves are never reversible, so only pieces are stored
+        for (Player player : { Player::WHITE, Player::BLACK }) {
+            for (int piece = Piece::KNIGHT; piece <= Piece::KING; piece++) {
+                for (int s1 = 0; s1 < NUM_SQUARES; s1++) {
+                    Bitboard attacks = 0;
+                    switch (piece) {
+                    case Piece::KNIGHT:
+                        attacks = Bitboards::KNIGHT_MOVES[s1];
+                        break;
+                    case Piece::BISHOP:
+                        attacks = Bitboards::getBishopMoveTable((Square)s1, 0);
+                        break;
+                    case Piece::ROOK:
+                        attacks = Bitboards::getRookMoveTable((Square)s1, 0);
+                        break;
+                    case Piece::QUEEN:
+                        attacks = Bitboards::getBishopMoveTable((Square)s1, 0) | Bitboards::getRookMoveTable((Square)s1, 0);
+                        break;
+                    case Piece::KING:
+                        attacks = Bitboards::KING_MOVES[s1];
+                        break;
+                    }
+
+                    for (int s2 = s1 + 1; s2 < NUM_SQUARES; s2++) {
+                        if ((attacks & Bitboards::oneAt((Square)s2)) == 0) {
+                            continue;
+                        }
+                        uint64_t key = Zobrist::KEYS.pieceSquare[player + piece][s1] ^
+                            Zobrist::KEYS.pieceSquare[player + piece][s2] ^ Zobrist::KEYS.blackToMove;
+                        Square from = (Square)s1;
+                        Square to = (Square)s2;
+
+                        // insert, evicting entries to their other slot until one lands in an empty slot
+                        int idx = hash1(key);
+                        while (true) {
+                            std::swap(keys[idx], key);
+                            std::swap(froms[idx], from);
+                            std::swap(tos[idx], to);
+                            if (from == Square::SQUARE_NONE) {
+                                break;
+                            }
+                            idx = idx == hash1(key) ? hash2(key) : hash1(key);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    bool lookup(uint64_t moveKey, Square& outFrom, Square& outTo) {
+        int idx = hash1(moveKey);
+        if (keys[idx] != moveKey) {
+            idx = hash2(moveKey);
+            if (keys[idx] != moveKey) {
+                return false;
+            }
+        }
+        outFrom = froms[idx];
+        outTo = tos[idx];
+        return true;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Bitboard.h"
+
+/***
+ * Cuckoo hash table of every reversible move, keyed by how the move changes the Zobrist hash
+ * (the piece's key on both squares and the side to move key).
+ *
+ * If the hash difference between the current position and an earlier one is in the table, a single
+ * reversible move may reach the earlier position, so a repetition can be detected one move before it happens.
+ * Moves and their reverse share an entry, so only the squares of the move are stored.
+ *
+ * Based on "Detecting repetitions" by Marcel van Kervinck.
+ */
+namespace Cuckoo {
+    const int TABLE_SIZE = 8192;
+
+    /***
+     * Fills the table. Requires the piece move boards to be initialized.
+     */
+    void init();
+
+    /***
+     * Looks up a hash difference. Returns false if no reversible move changes the hash by it.
+     */
+    bool lookup(uint64_t moveKey, Square& outFrom, Square& outTo);
+}
@@ -0,0 +1,77 @@
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile(const std::string& path, bool sequential) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    fileHandle = file;
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    fileSize = (size_t)size.QuadPart;
+    if (fileSize == 0) {
+        // empty files can't be mapped, but they are valid
+        opened = true;
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        return;
+    }
+    mappingHandle = mapping;
+    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat fileInfo;
+    fstat(fd, &fileInfo);
+    fileSize = (size_t)fileInfo.st_size;
+    if (fileSize == 0) {
+        // empty files can't be mapped, but they are valid
+        opened = true;
+        return;
+    }
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        return;
+    }
+    madvise(mapped, fileSize, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    data = mapped;
+#endif
+    opened = data != nullptr;
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle != nullptr) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != nullptr) {
+        CloseHandle(fileHandle);
+    }
+#else
+    if (data != nullptr) {
+        munmap((void*)data, fileSize);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+}
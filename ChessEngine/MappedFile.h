@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+/***
+ * A file mapped read-only into memory.
+ * Uses MapViewOfFile on Windows and mmap elsewhere. The mapping is released when the object is destroyed.
+ */
+class MappedFile
+{
+private:
+    const void* data = nullptr;
+    size_t fileSize = 0;
+    bool opened = false;
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+
+public:
+    /***
+     * Maps a file. If sequential is true, the OS is told the file will be read front to back.
+     */
+    MappedFile(const std::string& path, bool sequential = false);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /***
+     * Returns true if the file was successfully mapped. Empty files are valid but have no data.
+     */
+    bool isOpen() { return opened; }
+
+    const void* getData() { return data; }
+    size_t size() { return fileSize; }
+};
@@ -0,0 +1,264 @@
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+#include "MateSolver.h"
+
+/***
+ * Adds proof or disproof numbers. Infinity means the node is solved, so it's only reached
+ * through an infinite term; large finite sums stay just below it.
+ */
+static uint32_t addProofNumbers(uint32_t a, uint32_t b) {
+    if (a >= MateSolver::INFINITE_PN || b >= MateSolver::INFINITE_PN) {
+        return MateSolver::INFINITE_PN;
+    }
+    return std::min(a + b, MateSolver::INFINITE_PN - 1);
+}
+
+MateSolver::MateSolver(int hashMB) : hashMB(hashMB) {
+    // an unordered_map node holds the key, the entry and about 32 bytes of bookkeeping
+    size_t entrySize = sizeof(uint64_t) + sizeof(ProofEntry) + 32;
+    maxEntries = std::max<size_t>(1024, (size_t)hashMB * 1024 * 1024 / entrySize);
+}
+
+uint64_t MateSolver::nodeKey(Chessboard& board, int pliesLeft) {
+    return board.getHash() ^ ((uint64_t)pliesLeft * 0x9E3779B97F4A7C15ull);
+}
+
+MateSolver::ProofEntry MateSolver::lookup(uint64_t key) {
+    auto it = table.find(key);
+    if (it == table.end()) {
+        return { 1, 1, 0 };
+    }
+    return it->second;
+}
+
+void MateSolver::store(uint64_t key, uint32_t pn, uint32_t dn, uint64_t work) {
+    auto it = table.find(key);
+    if (it != table.end()) {
+        it->second = { pn, dn, it->second.work + work };
+        return;
+    }
+    if (table.size() >= maxEntries) {
+        collectGarbage();
+    }
+    table[key] = { pn, dn, work };
+}
+
+void MateSolver::collectGarbage() {
+    std::vector<uint64_t> works;
+    works.reserve(table.size());
+    for (auto& entry : table) {
+        works.push_back(entry.second.work);
+    }
+    size_t cutoffIdx = (size_t)(works.size() * GC_FRACTION);
+    std::nth_element(works.begin(), works.begin() + cutoffIdx, works.end());
+    uint64_t cutoff = works[cutoffIdx];
+
+    // most leaves have the same work, so if nothing is below the cutoff remove everything at it
+    size_t sizeBefore = table.size();
+    for (auto it = table.begin(); it != table.end();) {
+        it = it->second.work < cutoff ? table.erase(it) : std::next(it);
+    }
+    if (table.size() == sizeBefore) {
+        for (auto it = table.begin(); it != table.end();) {
+            it = it->second.work <= cutoff ? table.erase(it) : std::next(it);
+        }
+    }
+}
+
+uint64_t MateSolver::mid(Chessboard& board, int pliesLeft, bool attacking, uint32_t thpn, uint32_t thdn) {
+    uint64_t key = nodeKey(board, pliesLeft);
+    uint64_t work = 1;
+    if (++shared->nodes >= shared->maxNodes && shared->maxNodes > 0) {
+        shared->stop = true;
+    }
+
+    std::vector<Move> moves = board.generateAllLegalMoves();
+    if (moves.empty()) {
+        if (!attacking && board.isChecked(board.getTurn())) {
+            store(key, 0, INFINITE_PN, work);
+        }
+        else {
+            store(key, INFINITE_PN, 0, work);
+        }
+        return work;
+    }
+    if (pliesLeft == 0 || board.isRepetition() || board.isFiftyMoveDraw()) {
+        store(key, INFINITE_PN, 0, work);
+        return work;
+    }
+
+    // with one ply left only a check can mate
+    struct Child {
+        Move move;
+        uint64_t key;
+    };
+    std::vector<Child> children;
+    for (Move& m : moves) {
+        if (attacking && pliesLeft == 1 && !board.givesCheck(m)) {
+            continue;
+        }
+        MoveUndoInfo moveInfo = board.makeMove(m);
+        children.push_back({ m, nodeKey(board, pliesLeft - 1) });
+        board.undoMove(moveInfo);
+    }
+    if (children.empty()) {
+        store(key, INFINITE_PN, 0, work);
+        return work;
+    }
+
+    while (true) {
+        // an OR node needs one proven child and all children disproven, an AND node the opposite.
+        // "min" is the number the node takes from its best child and "sum" the one it adds up
+        uint32_t minValue = INFINITE_PN;
+        uint32_t secondValue = INFINITE_PN;
+        uint32_t sumValue = 0;
+        int bestIdx = 0;
+        ProofEntry best = { 1, 1, 0 };
+        for (int i = 0; i < (int)children.size(); i++) {
+            ProofEntry entry = lookup(children[i].key);
+            uint32_t value = attacking ? entry.pn : entry.dn;
+            sumValue = addProofNumbers(sumValue, attacking ? entry.dn : entry.pn);
+            if (value < minValue) {
+                secondValue = minValue;
+                minValue = value;
+                bestIdx = i;
+                best = entry;
+            }
+            else if (value < secondValue) {
+                secondValue = value;
+            }
+        }
+        uint32_t pn = attacking ? minValue : sumValue;
+        uint32_t dn = attacking ? sumValue : minValue;
+
+        if (pn >= thpn || dn >= thdn || shared->stop) {
+            store(key, pn, dn, work);
+            return work;
+        }
+
+        // search the best child until it's no longer better than the second best, or the parent exceeds its thresholds
+        uint32_t childThpn, childThdn;
+        if (attacking) {
+            childThpn = std::min(thpn, secondValue + 1);
+            childThdn = thdn >= INFINITE_PN ? INFINITE_PN : thdn - dn + best.dn;
+        }
+        else {
+            childThpn = thpn >= INFINITE_PN ? INFINITE_PN : thpn - pn + best.pn;
+            childThdn = std::min(thdn, secondValue + 1);
+        }
+
+        MoveUndoInfo moveInfo = board.makeMove(children[bestIdx].move);
+        work += mid(board, pliesLeft - 1, !attacking, childThpn, childThdn);
+        board.undoMove(moveInfo);
+    }
+}
+
+ProofResult MateSolver::prove(Chessboard& board, int pliesLeft, bool attacking) {
+    mid(board, pliesLeft, attacking, INFINITE_PN, INFINITE_PN);
+    ProofEntry entry = lookup(nodeKey(board, pliesLeft));
+    if (entry.pn == 0) {
+        return ProofResult::PROVEN;
+    }
+    if (entry.dn == 0) {
+        return ProofResult::DISPROVEN;
+    }
+    return ProofResult::UNKNOWN;
+}
+
+std::vector<Move> MateSolver::extractLine(Chessboard board, int pliesLeft, bool attacking) {
+    std::vector<Move> line;
+    while (pliesLeft > 0) {
+        bool found = false;
+        Move bestMove;
+        uint64_t bestWork = 0;
+        for (Move& m : board.generateAllLegalMoves()) {
+            MoveUndoInfo moveInfo = board.makeMove(m);
+            ProofEntry entry = lookup(nodeKey(board, pliesLeft - 1));
+            board.undoMove(moveInfo);
+            if (entry.pn != 0) {
+                continue;
+            }
+            // the attacker takes the simplest proof, the defender the hardest
+            if (!found || (attacking ? entry.work < bestWork : entry.work > bestWork)) {
+                found = true;
+                bestMove = m;
+                bestWork = entry.work;
+            }
+        }
+        if (!found) {
+            break; // checkmate, or the rest of the proof was garbage collected
+        }
+        line.push_back(bestMove);
+        board.makeMove(bestMove);
+        pliesLeft--;
+        attacking = !attacking;
+    }
+    return line;
+}
+
+MateSolution MateSolver::solve(Chessboard board, int maxMoves, int numThreads, uint64_t maxNodes) {
+    MateSolution solution;
+    if (maxMoves < 1) {
+        return solution;
+    }
+
+    SharedState state;
+    state.maxNodes = maxNodes;
+    int plies = 2 * maxMoves - 1;
+
+    if (numThreads <= 1) {
+        table.clear();
+        shared = &state;
+        solution.result = prove(board, plies, true);
+        if (solution.result == ProofResult::PROVEN) {
+            solution.pv = extractLine(board, plies, true);
+        }
+        shared = nullptr;
+    }
+    else {
+        // each root move is an independent AND node, so threads take root moves one at a time
+        std::vector<Move> moves = board.generateAllLegalMoves();
+        std::atomic<int> nextMove{ 0 };
+        std::atomic<int> numDisproven{ 0 };
+        std::mutex solutionMutex;
+        int threadHashMB = std::max(1, hashMB / numThreads);
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < numThreads; t++) {
+            workers.push_back(std::thread([&]() {
+                MateSolver worker(threadHashMB);
+                worker.shared = &state;
+                for (int i = nextMove++; i < (int)moves.size() && !state.stop; i = nextMove++) {
+                    Chessboard child = board;
+                    child.makeMove(moves[i]);
+                    ProofResult result = worker.prove(child, plies - 1, false);
+                    if (result == ProofResult::PROVEN) {
+                        std::lock_guard<std::mutex> lock(solutionMutex);
+                        if (solution.result != ProofResult::PROVEN) {
+                            solution.result = ProofResult::PROVEN;
+                            solution.pv = { moves[i] };
+                            std::vector<Move> rest = worker.extractLine(child, plies - 1, false);
+                            solution.pv.insert(solution.pv.end(), rest.begin(), rest.end());
+                        }
+                        state.stop = true;
+                    }
+                    else if (result == ProofResult::DISPROVEN) {
+                        numDisproven++;
+                    }
+                }
+            }));
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        if (solution.result != ProofResult::PROVEN && numDisproven == (int)moves.size()) {
+            solution.result = ProofResult::DISPROVEN;
+        }
+    }
+
+    solution.nodes = state.nodes;
+    return solution;
+}
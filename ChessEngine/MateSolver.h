@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "Chessboard.h"
+
+enum class ProofResult {
+    PROVEN,    // the side to move forces mate
+    DISPROVEN, // the side to move can't force mate within the limit
+    UNKNOWN    // the node limit was reached first
+};
+
+/***
+ * Result of MateSolver::solve
+ */
+struct MateSolution {
+    ProofResult result = ProofResult::UNKNOWN;
+    std::vector<Move> pv; // if proven, the mating line starting with the first move of the side to move
+    uint64_t nodes = 0;
+};
+
+/***
+ * Depth-first proof-number (df-pn) solver for forced mates.
+ *
+ * Instead of evaluating positions, every node has a proof number (how many leaves still have to be
+ * proven to show the attacker mates) and a disproof number (how many to show it doesn't). The search
+ * always expands the most proving node, which is usually a forcing line, so mates are found with far
+ * fewer nodes than alpha beta needs.
+ *
+ * Proof and disproof numbers are kept in a hashed node store of bounded size. When it fills up, the
+ * entries whose subtrees took the least work to compute are discarded, since they are the cheapest to redo.
+ */
+class MateSolver
+{
+private:
+    struct ProofEntry {
+        uint32_t pn;
+        uint32_t dn;
+        uint64_t work; // number of nodes searched below this node
+    };
+
+    // state shared by all threads solving a position
+    struct SharedState {
+        std::atomic<bool> stop{ false };
+        std::atomic<uint64_t> nodes{ 0 };
+        uint64_t maxNodes = 0;
+    };
+
+    // fraction of the entries removed by a garbage collection
+    static constexpr double GC_FRACTION = 0.5;
+
+    int hashMB;
+    size_t maxEntries;
+    std::unordered_map<uint64_t, ProofEntry> table;
+    SharedState* shared = nullptr;
+
+    /***
+     * The same position with a different number of plies left is a different node, since
+     * a mate in 3 may not be a mate in 2
+     */
+    static uint64_t nodeKey(Chessboard& board, int pliesLeft);
+
+    /***
+     * Returns the stored entry of a node, or pn = dn = 1 if it hasn't been searched
+     */
+    ProofEntry lookup(uint64_t key);
+
+    void store(uint64_t key, uint32_t pn, uint32_t dn, uint64_t work);
+
+    /***
+     * Removes the entries with the least work
+     */
+    void collectGarbage();
+
+    /***
+     * Searches a node until its proof number reaches thpn or its disproof number reaches thdn.
+     * The attacker is to move at OR nodes (attacking), the defender at AND nodes.
+     * Returns the number of nodes searched.
+     */
+    uint64_t mid(Chessboard& board, int pliesLeft, bool attacking, uint32_t thpn, uint32_t thdn);
+
+    /***
+     * Searches a node until it is proven, disproven or the search is stopped
+     */
+    ProofResult prove(Chessboard& board, int pliesLeft, bool attacking);
+
+    /***
+     * Follows proven nodes from a proven position to build the mating line. The defender
+     * plays the move whose proof took the most work, which is usually the longest resistance.
+     */
+    std::vector<Move> extractLine(Chessboard board, int pliesLeft, bool attacking);
+
+public:
+    static const int DEFAULT_HASH_MB = 64;
+    static const uint32_t INFINITE_PN = UINT32_MAX / 4;
+
+    MateSolver(int hashMB = DEFAULT_HASH_MB);
+
+    /***
+     * Proves whether the side to move can force mate in at most maxMoves moves.
+     *
+     * With multiple threads the root moves are split between them, each thread proving its moves
+     * with its own node store (of hashMB / numThreads). All threads stop as soon as one move is proven.
+     * If maxNodes isn't 0, the search gives up after searching that many nodes.
+     */
+    MateSolution solve(Chessboard board, int maxMoves, int numThreads = 1, uint64_t maxNodes = 0);
+
+    /***
+     * Returns the number of entries in the node store
+     */
+    size_t size() { return table.size(); }
+};
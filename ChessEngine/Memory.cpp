@@ -0,0 +1,149 @@
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+#ifdef __linux__
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#endif
+
+#include "Memory.h"
+
+#ifdef _WIN32
+/***
+ * Large pages have to be enabled for the process by the "Lock pages in memory" privilege,
+ * which the user must have been granted. Returns false if they can't be used.
+ */
+static bool enableLargePages() {
+    static int enabled = -1;
+    if (enabled >= 0) {
+        return enabled;
+    }
+    enabled = 0;
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+        return false;
+    }
+    TOKEN_PRIVILEGES privileges = { };
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    if (LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) &&
+        AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) && GetLastError() == ERROR_SUCCESS) {
+        enabled = 1;
+    }
+    CloseHandle(token);
+    return enabled;
+}
+#endif
+
+#ifdef __linux__
+/***
+ * Parses a sysfs list of cpus or nodes (ex: "0-3,8-11"). Returns an empty list if the file can't be read.
+ */
+static std::vector<int> readIdList(const std::string& path) {
+    std::vector<int> ids;
+    std::ifstream file(path);
+    std::string range;
+    while (std::getline(file, range, ',')) {
+        int first, last;
+        char dash;
+        std::istringstream rangeStream(range);
+        if (!(rangeStream >> first)) {
+            break;
+        }
+        last = (rangeStream >> dash >> last) ? last : first;
+        for (int id = first; id <= last; id++) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+/***
+ * Returns the cpus of each NUMA node that has any, read from sysfs. Empty if the machine doesn't report its nodes.
+ */
+static std::vector<cpu_set_t> readNodeCpus() {
+    std::vector<cpu_set_t> nodes;
+    for (int node : readIdList("/sys/devices/system/node/online")) {
+        std::vector<int> cpus = readIdList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (cpus.empty()) {
+            continue; // a node with memory but no cpus
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            CPU_SET(cpu, &set);
+        }
+        nodes.push_back(set);
+    }
+    return nodes;
+}
+#endif
+
+namespace Memory {
+    void* allocateLarge(size_t size, bool useLargePages, bool& usedLargePages) {
+        usedLargePages = false;
+        // round up to whole large pages
+        size = (size + LARGE_PAGE_SIZE - 1) / LARGE_PAGE_SIZE * LARGE_PAGE_SIZE;
+#ifdef _WIN32
+        if (useLargePages && GetLargePageMinimum() > 0 && enableLargePages()) {
+            size_t pageSize = GetLargePageMinimum();
+            void* mem = VirtualAlloc(NULL, (size + pageSize - 1) / pageSize * pageSize,
+                MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (mem != NULL) {
+                usedLargePages = true;
+                return mem;
+            }
+        }
+        return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+        void* mem = aligned_alloc(LARGE_PAGE_SIZE, size);
+        if (mem == nullptr) {
+            return nullptr;
+        }
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+        // explicitly opt out too, so turning large pages off doesn't depend on the system's default
+        usedLargePages = madvise(mem, size, useLargePages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE) == 0 && useLargePages;
+#endif
+        return mem;
+#endif
+    }
+
+    void freeLarge(void* mem) {
+        if (mem == nullptr) {
+            return;
+        }
+#ifdef _WIN32
+        VirtualFree(mem, 0, MEM_RELEASE);
+#else
+        free(mem);
+#endif
+    }
+
+    void bindThread(int index) {
+#ifdef _WIN32
+        ULONG highestNode;
+        if (!GetNumaHighestNodeNumber(&highestNode) || highestNode == 0) {
+            return; // a single node, the OS's scheduling is fine
+        }
+        GROUP_AFFINITY affinity;
+        if (GetNumaNodeProcessorMaskEx((USHORT)(index % (highestNode + 1)), &affinity)) {
+            SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+        }
+#elif defined(__linux__)
+        static const std::vector<cpu_set_t> nodes = readNodeCpus();
+        if (nodes.size() <= 1) {
+            return; // a single node, the OS's scheduling is fine
+        }
+        const cpu_set_t& cpus = nodes[index % nodes.size()];
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+
+/***
+ * Allocation of large tables (ex: the transposition table) and placement of the threads that use them.
+ *
+ * Large tables are backed by large pages (2 MB instead of 4 KB) when the OS allows it, so random accesses
+ * across the table don't miss the TLB on nearly every lookup. On Windows this is VirtualAlloc with
+ * MEM_LARGE_PAGES, which needs the "Lock pages in memory" privilege. Elsewhere the table is 2 MB aligned
+ * and marked with madvise(MADV_HUGEPAGE) for transparent huge pages.
+ *
+ * Memory is placed on the NUMA node of the thread that first writes it, so tables are cleared by threads
+ * bound with bindThread.
+ */
+namespace Memory {
+    static const size_t LARGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    /***
+     * Allocates size bytes, with large pages if useLargePages is set and they're available.
+     * Sets usedLargePages to whether they were used. Returns nullptr if the allocation failed.
+     */
+    void* allocateLarge(size_t size, bool useLargePages, bool& usedLargePages);
+
+    /***
+     * Frees memory from allocateLarge
+     */
+    void freeLarge(void* mem);
+
+    /***
+     * Binds the calling thread to the cpus of a NUMA node, round robin by index, so that threads with
+     * consecutive indices are spread over the nodes. Only done on multi-node machines. The nodes are read
+     * from the OS on Windows and from /sys/devices/system/node on Linux. Does nothing elsewhere.
+     */
+    void bindThread(int index);
+}
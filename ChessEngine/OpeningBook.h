@@ -0,0 +1,89 @@
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Chessboard.h"
+#include "MappedFile.h"
+
+/***
+ * A single book entry. On disk each entry is 16 bytes, big endian, and the file is sorted by key.
+ *
+ * MOVE FORMAT (bits):
+ *   0-2   to file
+ *   3-5   to rank
+ *   6-8   from file
+ *   9-11  from rank
+ *   12-14 promotion piece (0: none, 1: knight, 2: bishop, 3: rook, 4: queen)
+ * Castling is stored as the king capturing its own rook, ex: e1h1 for white kingside.
+ */
+struct BookEntry {
+    uint64_t key;
+    uint16_t move;
+    uint16_t weight;
+    uint32_t learn;
+};
+
+/***
+ * Opening book in the Polyglot .bin format.
+ *
+ * The book file is memory mapped and the entries of a position are found by binary searching its key.
+ */
+class OpeningBook
+{
+private:
+    static const size_t ENTRY_SIZE = 16;
+
+    std::unique_ptr<MappedFile> file;
+    const uint8_t* entries = nullptr;
+    size_t numEntries = 0;
+
+    /***
+     * Reads the entry at an index of the mapped file
+     */
+    BookEntry readEntry(size_t idx);
+
+public:
+    /***
+     * Maps a book file. Returns false if the file doesn't exist or isn't a valid book.
+     */
+    bool open(const std::string& path);
+
+    void close();
+
+    bool isOpen() { return entries != nullptr; }
+    size_t size() { return numEntries; }
+
+    /***
+     * Computes the book key of a position
+     */
+    static uint64_t computeKey(Chessboard& board);
+
+    /***
+     * Converts between legal moves and the book move format. decodeMove returns false if the
+     * book move isn't legal in the position.
+     */
+    static uint16_t encodeMove(Chessboard& board, Move m);
+    static bool decodeMove(Chessboard& board, uint16_t bookMove, Move& outMove);
+
+    /***
+     * Returns every entry stored for a key
+     */
+    std::vector<BookEntry> findEntries(uint64_t key);
+
+    /***
+     * Picks a book move for the position, with probability proportional to the entry weights.
+     * Returns false if the position isn't in the book.
+     */
+    bool pickMove(Chessboard& board, std::mt19937_64& rng, Move& outMove);
+
+    /***
+     * Builds a book from games written as UCI moves from the starting position, one game per line
+     * (ex: "e2e4 e7e5 g1f3"). Only the first maxPly moves of each game are stored, weighted by how
+     * often they were played. Returns the number of entries written, or -1 if the output can't be written.
+     */
+    static int build(std::istream& games, const std::string& outPath, int maxPly);
+};
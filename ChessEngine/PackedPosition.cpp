@@ -0,0 +1,22 @@
+
+#include "PackedPosition.h"
+
+PackedPositionWriter::PackedPositionWriter(const std::string& path, bool append, size_t bufferCapacity)
+    : out(path, std::ios::binary | (append ? std::ios::app : std::ios::trunc)), bufferCapacity(bufferCapacity) {
+    buffer.reserve(bufferCapacity);
+}
+
+void PackedPositionWriter::write(const PackedPosition& p) {
+    buffer.push_back(p);
+    if (buffer.size() >= bufferCapacity) {
+        flush();
+    }
+}
+
+void PackedPositionWriter::flush() {
+    if (!buffer.empty()) {
+        out.write((const char*)buffer.data(), buffer.size() * sizeof(PackedPosition));
+        buffer.clear();
+    }
+    out.flush();
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+/***
+ * PACKED POSITION FORMAT (32 bytes, little endian)
+ *
+ *  offset  size  field
+ *   0      8     occupancy      bitboard of all occupied squares
+ *   8      16    pieces         one nibble per occupied square, in order of increasing square index.
+ *                               the low nibble of each byte comes first. nibble = Player + Piece,
+ *                               the same index used for Chessboard::pieces (ex: black rook = 6 + 3 = 9)
+ *   24     1     flags          bit 0: black to move
+ *                               bits 1-4: castling rights (white kingside, white queenside,
+ *                                         black kingside, black queenside)
+ *   25     1     enPassant      en passant target square, 64 if there is none
+ *   26     1     halfMoveClock  (saturates at 255)
+ *   27     1     result         optional game result label from white's perspective: 1 win, 0 draw, -1 loss
+ *   28     2     fullMoveNumber
+ *   30     2     score          optional evaluation label in centipawns from white's perspective
+ *
+ * A legal position has at most 32 pieces, so the piece list always fits in 16 bytes.
+ * Records are stored back to back with no header, so a file of N positions is exactly 32 * N bytes.
+ */
+struct PackedPosition {
+    uint64_t occupancy;
+    uint8_t pieces[16];
+    uint8_t flags;
+    uint8_t enPassant;
+    uint8_t halfMoveClock;
+    int8_t result;
+    uint16_t fullMoveNumber;
+    int16_t score;
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must be exactly 32 bytes");
+
+namespace PackedPositions {
+    const uint8_t FLAG_BLACK_TO_MOVE = 1 << 0;
+    const uint8_t FLAG_WHITE_KINGSIDE = 1 << 1;
+    const uint8_t FLAG_WHITE_QUEENSIDE = 1 << 2;
+    const uint8_t FLAG_BLACK_KINGSIDE = 1 << 3;
+    const uint8_t FLAG_BLACK_QUEENSIDE = 1 << 4;
+
+    const uint8_t NO_EN_PASSANT = 64;
+
+    inline uint8_t getNibble(const PackedPosition& p, int i) { return (p.pieces[i / 2] >> ((i % 2) * 4)) & 0xF; }
+    inline void setNibble(PackedPosition& p, int i, uint8_t v) { p.pieces[i / 2] |= (v & 0xF) << ((i % 2) * 4); }
+}
+
+/***
+ * Read only view of a file of packed positions.
+ * The file is memory mapped, so records are accessed in place without being copied or parsed.
+ */
+class PackedPositionReader
+{
+private:
+    MappedFile file;
+    const PackedPosition* data;
+    size_t numPositions;
+
+public:
+    PackedPositionReader(const std::string& path)
+        : file(path, true), data((const PackedPosition*)file.getData()), numPositions(file.size() / sizeof(PackedPosition)) {}
+
+    /***
+     * Returns true if the file was successfully mapped
+     */
+    bool isOpen() { return file.isOpen(); }
+
+    size_t size() { return numPositions; }
+
+    const PackedPosition& operator[](size_t i) { return data[i]; }
+    const PackedPosition* begin() { return data; }
+    const PackedPosition* end() { return data + numPositions; }
+};
+
+/***
+ * Appends packed positions to a file, buffering them so that each write is large.
+ * Each writer owns its own buffer, so a thread should use its own writer (or its own file).
+ */
+class PackedPositionWriter
+{
+private:
+    std::ofstream out;
+    std::vector<PackedPosition> buffer;
+    size_t bufferCapacity;
+
+public:
+    PackedPositionWriter(const std::string& path, bool append = false, size_t bufferCapacity = 4096);
+    ~PackedPositionWriter() { flush(); }
+
+    bool isOpen() { return out.is_open(); }
+
+    void write(const PackedPosition& p);
+
+    /***
+     * Writes all buffered positions to the file
+     */
+    void flush();
+};
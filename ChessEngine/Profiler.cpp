@@ -0,0 +1,179 @@
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "Profiler.h"
+
+namespace Profiler {
+
+    std::atomic<bool> enabled{ false };
+
+    // number of events each thread keeps. once full, the oldest events are overwritten
+    const int RING_BUFFER_SIZE = 1 << 16;
+
+    struct Event {
+        ProfileStage stage;
+        int64_t start;
+        int64_t end;
+    };
+
+    /***
+     * Events and totals recorded by a single thread. Only the owning thread writes to it,
+     * so recording never takes a lock.
+     */
+    struct ThreadBuffer {
+        int threadId;
+        std::atomic<uint64_t> generation{ 0 }; // value of Profiler::generation when the buffer was last cleared
+        std::vector<Event> events = std::vector<Event>(RING_BUFFER_SIZE);
+        uint64_t numRecorded = 0; // total events recorded, the ring buffer index is numRecorded % RING_BUFFER_SIZE
+
+        // totals are kept separately so that they stay exact when the ring buffer wraps around
+        int64_t totalTime[NUM_PROFILE_STAGES] = { };
+        uint64_t numCalls[NUM_PROFILE_STAGES] = { };
+    };
+
+    /*
+     * Every buffer ever created is kept in buffers so that its events can be reported after its thread
+     * ends. A new search thread is started for every "go", so buffers of finished threads are put on
+     * a free list and reused, and memory is bounded by the number of threads alive at once.
+     */
+    std::mutex buffersMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer*> freeBuffers;
+
+    // incremented by reset. Buffers from an older generation are treated as empty
+    std::atomic<uint64_t> generation{ 1 };
+
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    /***
+     * Returns a thread's buffer to the free list when the thread exits
+     */
+    struct BufferOwner {
+        ThreadBuffer* buffer = nullptr;
+
+        ~BufferOwner() {
+            if (buffer != nullptr) {
+                std::lock_guard<std::mutex> lock(buffersMutex);
+                freeBuffers.push_back(buffer);
+            }
+        }
+    };
+
+    void clearBuffer(ThreadBuffer& buffer, uint64_t newGeneration) {
+        buffer.numRecorded = 0;
+        for (int s = 0; s < NUM_PROFILE_STAGES; s++) {
+            buffer.totalTime[s] = 0;
+            buffer.numCalls[s] = 0;
+        }
+        buffer.generation.store(newGeneration, std::memory_order_release);
+    }
+
+    ThreadBuffer& getThreadBuffer() {
+        thread_local BufferOwner owner;
+        if (owner.buffer == nullptr) {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            if (!freeBuffers.empty()) {
+                owner.buffer = freeBuffers.back();
+                freeBuffers.pop_back();
+            }
+            else {
+                buffers.push_back(std::make_unique<ThreadBuffer>());
+                owner.buffer = buffers.back().get();
+                owner.buffer->threadId = (int)buffers.size();
+            }
+        }
+        uint64_t currentGeneration = generation.load(std::memory_order_acquire);
+        if (owner.buffer->generation.load(std::memory_order_relaxed) != currentGeneration) {
+            clearBuffer(*owner.buffer, currentGeneration);
+        }
+        return *owner.buffer;
+    }
+
+    /***
+     * Returns true if a buffer holds events recorded since the last reset
+     */
+    bool isCurrent(const ThreadBuffer& buffer) {
+        return buffer.generation.load(std::memory_order_acquire) == generation.load(std::memory_order_acquire);
+    }
+
+    const char* stageName(ProfileStage stage) {
+        const char* names[] = { "movegen", "make/unmake", "evaluate", "tt probe", "move picker" };
+        return names[stage];
+    }
+
+    int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void record(ProfileStage stage, int64_t start, int64_t end) {
+        ThreadBuffer& buffer = getThreadBuffer();
+        buffer.events[buffer.numRecorded % RING_BUFFER_SIZE] = { stage, start, end };
+        buffer.numRecorded++;
+        buffer.totalTime[stage] += end - start;
+        buffer.numCalls[stage]++;
+    }
+
+    void reset() {
+        generation++;
+    }
+
+    std::string stageBreakdown() {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        int64_t totalTime[NUM_PROFILE_STAGES] = { };
+        uint64_t numCalls[NUM_PROFILE_STAGES] = { };
+        int64_t sumOfStages = 0;
+        for (auto& buffer : buffers) {
+            if (!isCurrent(*buffer)) {
+                continue;
+            }
+            for (int s = 0; s < NUM_PROFILE_STAGES; s++) {
+                totalTime[s] += buffer->totalTime[s];
+                numCalls[s] += buffer->numCalls[s];
+                sumOfStages += buffer->totalTime[s];
+            }
+        }
+
+        std::stringstream out;
+        for (int s = 0; s < NUM_PROFILE_STAGES; s++) {
+            out << "info string profile " << stageName((ProfileStage)s)
+                << " time " << totalTime[s] / 1000000.0 << "ms"
+                << " calls " << numCalls[s]
+                << " avg " << (numCalls[s] == 0 ? 0 : totalTime[s] / (double)numCalls[s]) << "ns"
+                << " share " << (sumOfStages == 0 ? 0 : 100.0 * totalTime[s] / sumOfStages) << "%";
+            if (s + 1 < NUM_PROFILE_STAGES) {
+                out << "\n";
+            }
+        }
+        return out.str();
+    }
+
+    void writeChromeTrace(const std::string& path) {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        std::ofstream out(path);
+        out << std::fixed << std::setprecision(3);
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        for (auto& buffer : buffers) {
+            if (!isCurrent(*buffer)) {
+                continue;
+            }
+            uint64_t numEvents = buffer->numRecorded < RING_BUFFER_SIZE ? buffer->numRecorded : RING_BUFFER_SIZE;
+            uint64_t oldest = buffer->numRecorded - numEvents;
+            for (uint64_t i = oldest; i < buffer->numRecorded; i++) {
+                Event& e = buffer->events[i % RING_BUFFER_SIZE];
+                // chrome traces use microseconds
+                out << (first ? "" : ",") << "\n{\"name\":\"" << stageName(e.stage) << "\",\"ph\":\"X\""
+                    << ",\"ts\":" << e.start / 1000.0 << ",\"dur\":" << (e.end - e.start) / 1000.0
+                    << ",\"pid\":1,\"tid\":" << buffer->threadId << "}";
+                first = false;
+            }
+        }
+        out << "\n]}\n";
+    }
+}
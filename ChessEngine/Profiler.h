@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+/***
+ * Stages of the search that can be timed by the profiler
+ */
+enum ProfileStage {
+    MOVE_GENERATION,
+    MAKE_UNMAKE,
+    EVALUATION,
+    TT_PROBE,
+    MOVE_PICKER,
+    NUM_PROFILE_STAGES
+};
+
+namespace Profiler {
+
+    /***
+     * Profiling is switched on and off at runtime (by the UCI thread, while search threads read it).
+     * When disabled, a ScopedTimer only costs a relaxed load and a branch on this flag.
+     */
+    extern std::atomic<bool> enabled;
+
+    /***
+     * Returns the name of a stage as it appears in traces and breakdowns
+     */
+    const char* stageName(ProfileStage stage);
+
+    /***
+     * Returns the number of nanoseconds since the profiler was first used
+     */
+    int64_t now();
+
+    /***
+     * Records a completed stage to the calling thread's ring buffer
+     */
+    void record(ProfileStage stage, int64_t start, int64_t end);
+
+    /***
+     * Clears the events and totals of all threads. Each thread clears its own buffer the next time it
+     * records, so this never writes to a buffer another thread may be using.
+     */
+    void reset();
+
+    /***
+     * Returns UCI "info string" lines containing the total time, call count and
+     * share of profiled time spent in each stage.
+     * Stages may be nested (ex: move generation inside the move picker), so shares
+     * are relative to the sum of all stages rather than the wall time of the search.
+     */
+    std::string stageBreakdown();
+
+    /***
+     * Writes all buffered events to a file in the Chrome trace-event JSON format,
+     * which can be viewed in chrome://tracing or https://ui.perfetto.dev
+     */
+    void writeChromeTrace(const std::string& path);
+
+    /***
+     * Times the enclosing scope as a given stage if profiling is enabled
+     */
+    class ScopedTimer {
+    private:
+        ProfileStage stage;
+        int64_t start;
+        bool active;
+
+    public:
+        ScopedTimer(ProfileStage s) : stage(s), active(enabled.load(std::memory_order_relaxed)) {
+            if (active) {
+                start = now();
+            }
+        }
+
+        ~ScopedTimer() {
+            if (active) {
+                record(stage, start, now());
+            }
+        }
+    };
+}
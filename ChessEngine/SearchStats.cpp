@@ -0,0 +1,47 @@
+
+#include <sstream>
+
+#include "SearchStats.h"
+
+double SearchStats::branchingFactor(int ply) const {
+    if (ply + 1 >= MAX_PLY || nodesAtPly[ply] == 0) {
+        return 0;
+    }
+    return (double)nodesAtPly[ply + 1] / nodesAtPly[ply];
+}
+
+std::string SearchStats::toInfoString() const {
+    std::stringstream out;
+    out << "info string nodes " << nodes << " qnodes " << qnodes << "\n";
+    out << "info string tt probes " << ttProbes << " hits " << ttHits << " cutoffs " << ttCutoffs << "\n";
+    out << "info string cutoffs " << betaCutoffs << " firstmove " << firstMoveCutoffs << "\n";
+    out << "info string checkextensions " << checkExtensions << " iirreductions " << iirReductions << "\n";
+    out << "info string singular " << singularExtensions << " multicuts " << multiCuts << "\n";
+    out << "info string tbhits " << tbHits << " repetitiondraws " << repetitionDraws << "\n";
+    out << "info string branching";
+    for (int ply = 0; ply + 1 < MAX_PLY && nodesAtPly[ply + 1] != 0; ply++) {
+        out << " " << branchingFactor(ply);
+    }
+    return out.str();
+}
+
+std::string SearchStats::toJSON() const {
+    std::stringstream out;
+    out << "{";
+    out << "\"nodes\":" << nodes << ",\"qnodes\":" << qnodes;
+    out << ",\"ttProbes\":" << ttProbes << ",\"ttHits\":" << ttHits << ",\"ttCutoffs\":" << ttCutoffs;
+    out << ",\"betaCutoffs\":" << betaCutoffs << ",\"firstMoveCutoffs\":" << firstMoveCutoffs;
+    out << ",\"checkExtensions\":" << checkExtensions << ",\"iirReductions\":" << iirReductions;
+    out << ",\"singularExtensions\":" << singularExtensions << ",\"multiCuts\":" << multiCuts;
+    out << ",\"tbHits\":" << tbHits << ",\"repetitionDraws\":" << repetitionDraws;
+    out << ",\"nodesAtPly\":[";
+    for (int ply = 0; ply < MAX_PLY && nodesAtPly[ply] != 0; ply++) {
+        out << (ply == 0 ? "" : ",") << nodesAtPly[ply];
+    }
+    out << "],\"branchingFactor\":[";
+    for (int ply = 0; ply + 1 < MAX_PLY && nodesAtPly[ply + 1] != 0; ply++) {
+        out << (ply == 0 ? "" : ",") << branchingFactor(ply);
+    }
+    out << "]}";
+    return out.str();
+}
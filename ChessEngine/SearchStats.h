@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+/***
+ * Search statistics are only collected when SEARCH_STATS is defined (enabled for Debug builds).
+ * Otherwise every STATS_* macro expands to nothing, so release builds pay no cost for them.
+ */
+#ifdef SEARCH_STATS
+#define STATS_INC(stats, field) ((stats).field++)
+#define STATS_INC_PLY(stats, ply) ((stats).recordNodeAtPly(ply))
+#else
+#define STATS_INC(stats, field) ((void)0)
+#define STATS_INC_PLY(stats, ply) ((void)0)
+#endif
+
+/***
+ * Counters describing the behavior of a single search.
+ * Each searching thread owns its own SearchStats so counters are never shared between threads.
+ * nodes is always counted since it is reported outside of debugging (ex: UCI info, batch analysis).
+ */
+struct SearchStats {
+    static const int MAX_PLY = 64;
+
+    uint64_t nodes = 0;             // nodes visited by the main search
+    uint64_t qnodes = 0;            // nodes visited by the quiescence search
+
+    uint64_t ttProbes = 0;          // transposition table lookups
+    uint64_t ttHits = 0;            // lookups that found an entry for the position
+    uint64_t ttCutoffs = 0;         // lookups whose entry allowed returning immediately
+
+    uint64_t betaCutoffs = 0;       // nodes where a move caused a cutoff
+    uint64_t firstMoveCutoffs = 0;  // cutoffs caused by the first move searched (measures move ordering)
+
+    uint64_t checkExtensions = 0;   // checking moves searched one ply deeper
+    uint64_t iirReductions = 0;     // nodes searched a ply shallower for lack of a transposition table move
+    uint64_t singularExtensions = 0; // table moves searched a ply deeper because no other move came close
+    uint64_t multiCuts = 0;         // nodes cut because a move other than the table's also beat beta
+
+    uint64_t tbHits = 0;            // nodes resolved by a tablebase lookup
+    uint64_t repetitionDraws = 0;   // nodes scored as a draw by repetition or the 50 move rule
+
+    uint64_t nodesAtPly[MAX_PLY] = { }; // used to compute the branching factor at each depth
+
+    void reset() { *this = SearchStats(); }
+
+    void recordNodeAtPly(int ply) {
+        if (ply < MAX_PLY) {
+            nodesAtPly[ply]++;
+        }
+    }
+
+    /***
+     * Returns the average number of children searched per node at a given ply.
+     */
+    double branchingFactor(int ply) const;
+
+    /***
+     * Returns the stats as human readable lines suitable for UCI "info string" output
+     */
+    std::string toInfoString() const;
+
+    /***
+     * Returns the stats as a single line JSON object
+     */
+    std::string toJSON() const;
+};
@@ -0,0 +1,133 @@
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "Memory.h"
+#include "SelfPlay.h"
+
+SelfPlay::SelfPlay(SelfPlayOptions options) : options(options) {
+    if (this->options.numThreads < 1) {
+        this->options.numThreads = 1;
+    }
+}
+
+bool SelfPlay::isInsufficientMaterial(Chessboard& board) {
+    int minorPieces = 0;
+    for (Player p : { Player::WHITE, Player::BLACK }) {
+        if (board.countPieces(p, Piece::PAWN) || board.countPieces(p, Piece::ROOK) || board.countPieces(p, Piece::QUEEN)) {
+            return false;
+        }
+        minorPieces += board.countPieces(p, Piece::KNIGHT) + board.countPieces(p, Piece::BISHOP);
+    }
+    // a single minor piece can't force checkmate
+    return minorPieces <= 1;
+}
+
+int SelfPlay::playGame(ChessEngine& engine, std::mt19937_64& rng, std::vector<PackedPosition>& outPositions) {
+    engine.board = Chessboard();
+
+    for (int i = 0; i < options.randomPlies; i++) {
+        std::vector<Move> moves = engine.board.generateAllLegalMoves();
+        if (moves.empty()) {
+            break;
+        }
+        std::uniform_int_distribution<size_t> dist(0, moves.size() - 1);
+        engine.board.makeMove(moves[dist(rng)]);
+    }
+
+    int consecutiveWinningPlies = 0;
+    for (int ply = 0; ply < options.maxPlies; ply++) {
+        Player turn = engine.board.getTurn();
+        std::vector<Move> moves = engine.board.generateAllLegalMoves();
+        if (moves.empty()) {
+            if (engine.board.isChecked(turn)) {
+                return turn == Player::WHITE ? -1 : 1;
+            }
+            return 0; // stalemate
+        }
+        // a repeated position is scored as a draw, like the search does, so shuffling games end
+        // instead of filling the output with the same positions until maxPlies
+        if (engine.board.isFiftyMoveDraw() || engine.board.isRepetition() || isInsufficientMaterial(engine.board)) {
+            return 0;
+        }
+
+        Move m = engine.search(options.depth);
+        int eval = engine.getLastEval();
+
+        // adjudicate once one side has been clearly winning for a while
+        consecutiveWinningPlies = (eval >= options.winThreshold || eval <= -options.winThreshold) ? consecutiveWinningPlies + 1 : 0;
+        if (consecutiveWinningPlies >= options.winPlies) {
+            return eval > 0 ? 1 : -1;
+        }
+
+        if (!m.isCapture && !engine.board.isChecked(turn)) {
+            PackedPosition p = engine.board.toPacked();
+            p.score = (int16_t)(eval > INT16_MAX ? INT16_MAX : (eval < INT16_MIN ? INT16_MIN : eval));
+            outPositions.push_back(p);
+        }
+
+        engine.board.makeMove(m);
+    }
+
+    return 0; // game took too long
+}
+
+void SelfPlay::workerLoop(int threadIdx) {
+    // bind before the engine exists so its transposition table is placed near the thread
+    Memory::bindThread(threadIdx);
+    ChessEngine engine;
+    std::random_device seeder;
+    std::mt19937_64 rng(seeder() + threadIdx);
+    PackedPositionWriter writer(options.outputPath + "." + std::to_string(threadIdx));
+    std::vector<PackedPosition> gamePositions;
+
+    while (positionsWritten < options.numPositions) {
+        gamePositions.clear();
+        int result = playGame(engine, rng, gamePositions);
+        for (PackedPosition& p : gamePositions) {
+            p.result = (int8_t)result;
+            writer.write(p);
+        }
+        positionsWritten += gamePositions.size();
+        gamesPlayed++;
+    }
+}
+
+void SelfPlay::run() {
+    Bitboards::initPieceMoveBoards();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.numThreads; i++) {
+        workers.push_back(std::thread(&SelfPlay::workerLoop, this, i));
+    }
+
+    // report progress until all workers are done
+    while (positionsWritten < options.numPositions) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        double minutes = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / 60;
+        std::cerr << "\rgames " << gamesPlayed << " positions " << positionsWritten
+                  << " (" << (uint64_t)(positionsWritten / minutes) << "/min)" << std::flush;
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::cerr << std::endl;
+
+    // merge the per-thread files. packed files have no header, so they can simply be concatenated
+    std::ofstream out(options.outputPath, std::ios::binary);
+    for (int i = 0; i < options.numThreads; i++) {
+        std::string threadPath = options.outputPath + "." + std::to_string(i);
+        {
+            std::ifstream in(threadPath, std::ios::binary);
+            if (in.peek() != std::ifstream::traits_type::eof()) {
+                out << in.rdbuf();
+            }
+        }
+        std::remove(threadPath.c_str());
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <random>
+#include <string>
+
+#include "ChessEngine.h"
+#include "PackedPosition.h"
+
+/***
+ * Settings for a self-play data generation run
+ */
+struct SelfPlayOptions {
+    std::string outputPath;
+    int numThreads = 1;
+    int depth = 4;
+    uint64_t numPositions = 100000; // stop once this many positions have been written
+    int randomPlies = 8;            // number of random moves played at the start of each game
+    int maxPlies = 400;             // games longer than this are adjudicated as draws
+    int winThreshold = 1000;        // |eval| needed to adjudicate a win
+    int winPlies = 6;               // number of consecutive plies the eval must stay above winThreshold
+};
+
+/***
+ * Generates training positions by having the engine play games against itself.
+ *
+ * Each game starts with a few random moves so games are diverse, then both sides play using a
+ * fixed depth search. Positions where the side to move is in check or where the best move is a
+ * capture are skipped since their static evaluation is not representative. Once a game ends,
+ * its positions are written with the search score and the game result as packed positions.
+ *
+ * Each thread writes to its own file through a buffered writer so threads never wait on each other.
+ * The per-thread files are concatenated into the output file once generation finishes.
+ */
+class SelfPlay
+{
+private:
+    SelfPlayOptions options;
+
+    std::atomic<uint64_t> positionsWritten{ 0 };
+    std::atomic<uint64_t> gamesPlayed{ 0 };
+
+    /***
+     * Plays games and writes their positions until enough positions have been generated
+     */
+    void workerLoop(int threadIdx);
+
+    /***
+     * Plays a single game, appending its positions to outPositions.
+     * Returns the result of the game from white's perspective (1 win, 0 draw, -1 loss).
+     */
+    int playGame(ChessEngine& engine, std::mt19937_64& rng, std::vector<PackedPosition>& outPositions);
+
+    /***
+     * Returns true if neither side has enough material to checkmate
+     */
+    static bool isInsufficientMaterial(Chessboard& board);
+
+public:
+    SelfPlay(SelfPlayOptions options);
+
+    void run();
+};
@@ -0,0 +1,261 @@
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <intrin.h>
+
+#include "Tablebase.h"
+
+const char* const Tablebases::SUPPORTED_TABLES[NUM_SUPPORTED_TABLES] = { "KQvK", "KRvK", "KPvK" };
+
+/***
+ * TABLE FILE FORMAT
+ *   4 bytes  magic "CETB"
+ *   4 bytes  version
+ *   8 bytes  table name, zero padded
+ *   TABLE_SIZE bytes of values
+ */
+static const char TABLE_MAGIC[4] = { 'C', 'E', 'T', 'B' };
+static const uint32_t TABLE_VERSION = 1;
+static const size_t TABLE_HEADER_SIZE = 16;
+
+bool Tablebases::parseName(const std::string& name, Table& outTable) {
+    size_t separator = name.find('v');
+    if (separator == std::string::npos || name.size() != MAX_PIECES + 1) {
+        return false;
+    }
+    const std::string pieceNames = "PNBRQK";
+    for (int i = 0, slot = 0; i < (int)name.size(); i++) {
+        if (i == (int)separator) {
+            continue;
+        }
+        size_t piece = pieceNames.find(name[i]);
+        if (piece == std::string::npos) {
+            return false;
+        }
+        outTable.slots[slot] = { i < (int)separator ? Player::WHITE : Player::BLACK, (Piece)piece };
+        slot++;
+    }
+    outTable.name = name;
+    return true;
+}
+
+bool Tablebases::computeIndex(const Table& table, Chessboard& board, bool flip, uint32_t& outIndex) {
+    Player stm = flip ? Players::getEnemy(board.getTurn()) : board.getTurn();
+    uint32_t index = stm == Player::BLACK ? 1 : 0;
+    for (const Slot& slot : table.slots) {
+        Bitboard bb = board.getPieces(flip ? Players::getEnemy(slot.player) : slot.player, slot.piece);
+        if (__popcnt64(bb) != 1) {
+            return false;
+        }
+        unsigned long sq = 0;
+        _BitScanForward64(&sq, bb);
+        index = index * 64 + (flip ? sq ^ 56 : sq);
+    }
+    outIndex = index;
+    return true;
+}
+
+bool Tablebases::probe(Chessboard& board, int& outValue) {
+    int numPieces = (int)__popcnt64(board.getAllPieces());
+    if (numPieces > MAX_PIECES) {
+        return false;
+    }
+
+    // lone kings, or kings and a single minor piece, can never checkmate
+    Bitboard kings = board.getPieces(Player::WHITE, Piece::KING) | board.getPieces(Player::BLACK, Piece::KING);
+    Bitboard minors = board.getPieces(Player::WHITE, Piece::KNIGHT) | board.getPieces(Player::BLACK, Piece::KNIGHT) |
+        board.getPieces(Player::WHITE, Piece::BISHOP) | board.getPieces(Player::BLACK, Piece::BISHOP);
+    Bitboard others = board.getAllPieces() & ~kings;
+    if (others == 0 || (others == minors && __popcnt64(minors) == 1)) {
+        outValue = 0;
+        return true;
+    }
+
+    for (auto& table : tables) {
+        uint32_t index;
+        if (computeIndex(*table, board, false, index) || computeIndex(*table, board, true, index)) {
+            outValue = table->values[index];
+            return true;
+        }
+    }
+    return false;
+}
+
+int Tablebases::load(const std::string& dir) {
+    tables.clear();
+    cardinality = 0;
+    for (const char* name : SUPPORTED_TABLES) {
+        std::unique_ptr<Table> table = std::make_unique<Table>();
+        parseName(name, *table);
+        table->file = std::make_unique<MappedFile>(dir + "/" + name + ".cetb");
+        if (!table->file->isOpen() || table->file->size() != TABLE_HEADER_SIZE + TABLE_SIZE) {
+            continue;
+        }
+        const char* data = (const char*)table->file->getData();
+        uint32_t version;
+        std::memcpy(&version, data + 4, sizeof(version));
+        if (std::memcmp(data, TABLE_MAGIC, 4) != 0 || version != TABLE_VERSION) {
+            continue;
+        }
+        table->values = (const int8_t*)(data + TABLE_HEADER_SIZE);
+        tables.push_back(std::move(table));
+        cardinality = MAX_PIECES;
+    }
+    return (int)tables.size();
+}
+
+bool Tablebases::generate(const std::string& name, const std::string& dir) {
+    std::unique_ptr<Table> table = std::make_unique<Table>();
+    if (!parseName(name, *table)) {
+        return false;
+    }
+
+    /*
+     * Build the move graph. Moves that keep the same material lead to another position in this table
+     * and are stored as child indices. Moves that capture or promote leave the table; their values are
+     * already known, so they are stored directly, tagged with EXIT_FLAG.
+     */
+    const uint32_t EXIT_FLAG = 1u << 31;
+    std::vector<uint32_t> childStart(TABLE_SIZE + 1);
+    std::vector<uint32_t> children;
+    std::vector<int8_t> values(TABLE_SIZE, 0);
+    std::vector<bool> resolved(TABLE_SIZE, false);
+    int maxExitDistance = 0;
+
+    for (uint32_t index = 0; index < TABLE_SIZE; index++) {
+        childStart[index] = (uint32_t)children.size();
+
+        // decode the index into a board
+        Player stm = (index >> 18) ? Player::BLACK : Player::WHITE;
+        std::pair<int, int> squareAndBoard[MAX_PIECES];
+        Bitboard occupancy = 0;
+        bool valid = true;
+        for (int slot = 0; slot < MAX_PIECES; slot++) {
+            int sq = (index >> (6 * (MAX_PIECES - 1 - slot))) & 63;
+            const Slot& s = table->slots[slot];
+            bool pawnOnBackRank = s.piece == Piece::PAWN && (Squares::getRank((Square)sq) == RANK_1 || Squares::getRank((Square)sq) == RANK_8);
+            if ((occupancy & Bitboards::oneAt((Square)sq)) || pawnOnBackRank) {
+                valid = false;
+            }
+            occupancy |= Bitboards::oneAt((Square)sq);
+            squareAndBoard[slot] = { sq, s.player + s.piece };
+        }
+        if (!valid) {
+            resolved[index] = true; // illegal, stored as 0
+            continue;
+        }
+        std::sort(squareAndBoard, squareAndBoard + MAX_PIECES);
+        PackedPosition packed = { };
+        packed.occupancy = occupancy;
+        packed.flags = stm == Player::BLACK ? PackedPositions::FLAG_BLACK_TO_MOVE : 0;
+        packed.enPassant = PackedPositions::NO_EN_PASSANT;
+        packed.fullMoveNumber = 1;
+        for (int i = 0; i < MAX_PIECES; i++) {
+            PackedPositions::setNibble(packed, i, (uint8_t)squareAndBoard[i].second);
+        }
+        Chessboard board = Chessboard(packed);
+
+        if (board.isChecked(Players::getEnemy(stm))) {
+            resolved[index] = true; // side that just moved can't be in check
+            continue;
+        }
+
+        std::vector<Move> moves = board.generateAllLegalMoves();
+        if (moves.empty()) {
+            resolved[index] = true;
+            values[index] = board.isChecked(stm) ? -1 : 0; // checkmated or stalemated
+            continue;
+        }
+
+        for (Move& m : moves) {
+            MoveUndoInfo undoInfo = board.makeMove(m);
+            uint32_t childIndex;
+            if (m.promotion == Piece::PIECE_NONE && computeIndex(*table, board, false, childIndex)) {
+                children.push_back(childIndex);
+            }
+            else {
+                int exitValue;
+                if (!probe(board, exitValue)) {
+                    return false; // a table this one depends on isn't available
+                }
+                maxExitDistance = std::max(maxExitDistance, getDistance(exitValue));
+                children.push_back(EXIT_FLAG | (uint8_t)(int8_t)exitValue);
+            }
+            board.undoMove(undoInfo);
+        }
+    }
+    childStart[TABLE_SIZE] = (uint32_t)children.size();
+
+    /*
+     * Resolve positions in order of increasing distance to mate. A position is won in d plies if a move
+     * leads to a child that is lost in d - 1 plies, and lost in d plies if every move leads to a child
+     * that is won, the longest of which is won in d - 1 plies. Positions never resolved are draws.
+     */
+    for (int d = 1; d < 127; d++) {
+        bool changed = false;
+        for (uint32_t index = 0; index < TABLE_SIZE; index++) {
+            if (resolved[index]) {
+                continue;
+            }
+            bool foundWin = false;
+            bool allChildrenWon = true;
+            int longestWin = 0;
+            for (uint32_t c = childStart[index]; c < childStart[index + 1]; c++) {
+                int childValue;
+                if (children[c] & EXIT_FLAG) {
+                    childValue = (int8_t)(children[c] & 0xFF);
+                }
+                else if (resolved[children[c]]) {
+                    childValue = values[children[c]];
+                }
+                else {
+                    allChildrenWon = false;
+                    continue;
+                }
+
+                if (isLoss(childValue) && getDistance(childValue) == d - 1) {
+                    foundWin = true;
+                    break;
+                }
+                if (isWin(childValue)) {
+                    longestWin = std::max(longestWin, getDistance(childValue));
+                }
+                else {
+                    allChildrenWon = false;
+                }
+            }
+
+            if (foundWin) {
+                values[index] = (int8_t)d;
+                resolved[index] = true;
+                changed = true;
+            }
+            else if (allChildrenWon && longestWin == d - 1) {
+                values[index] = (int8_t)(-d - 1);
+                resolved[index] = true;
+                changed = true;
+            }
+        }
+        if (!changed && d > maxExitDistance + 1) {
+            break;
+        }
+    }
+
+    std::ofstream out(dir + "/" + name + ".cetb", std::ios::binary);
+    char header[TABLE_HEADER_SIZE] = { };
+    std::memcpy(header, TABLE_MAGIC, 4);
+    std::memcpy(header + 4, &TABLE_VERSION, sizeof(TABLE_VERSION));
+    std::memcpy(header + 8, name.c_str(), std::min(name.size(), (size_t)8));
+    out.write(header, TABLE_HEADER_SIZE);
+    out.write((const char*)values.data(), TABLE_SIZE);
+    if (!out) {
+        return false;
+    }
+
+    table->generated = std::move(values);
+    table->values = table->generated.data();
+    tables.push_back(std::move(table));
+    cardinality = MAX_PIECES;
+    return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Chessboard.h"
+#include "MappedFile.h"
+
+/***
+ * Endgame tablebases for positions with 3 pieces (kings included), ex: KQvK, KRvK, KPvK.
+ *
+ * Tables are generated locally by retrograde analysis ("ChessEngine tbgen") and memory mapped when loaded.
+ * Each table stores one byte per position, indexed by side to move and the square of each piece:
+ *   index = (stm * 64 + square of piece 0) * 64 * 64 + (square of piece 1) * 64 + square of piece 2
+ * Tables are stored with the side that has the extra piece as white. Positions where black has the
+ * extra piece are probed by mirroring the board vertically and swapping colors.
+ *
+ * VALUE FORMAT (from the perspective of the side to move):
+ *    0     draw (or illegal position)
+ *    d > 0 win, the side to move can force checkmate in d plies
+ *    d < 0 loss, the side to move gets checkmated in (-d - 1) plies (-1 means checkmated now)
+ */
+class Tablebases
+{
+public:
+    static const int MAX_PIECES = 3;
+    static const int TABLE_SIZE = 2 * 64 * 64 * 64;
+
+    // tables that tbgen creates, in an order where each table only depends on the ones before it
+    static const int NUM_SUPPORTED_TABLES = 3;
+    static const char* const SUPPORTED_TABLES[NUM_SUPPORTED_TABLES];
+
+    static bool isWin(int value) { return value > 0; }
+    static bool isLoss(int value) { return value < 0; }
+
+    /***
+     * Returns the number of plies until checkmate for a won or lost value
+     */
+    static int getDistance(int value) { return value > 0 ? value : -value - 1; }
+
+private:
+    struct Slot {
+        Player player;
+        Piece piece;
+    };
+
+    struct Table {
+        std::string name;
+        Slot slots[MAX_PIECES];
+        std::unique_ptr<MappedFile> file; // set if the table was loaded from disk
+        std::vector<int8_t> generated;    // set if the table was generated in this process
+        const int8_t* values = nullptr;
+    };
+
+    std::vector<std::unique_ptr<Table>> tables;
+    int cardinality = 0;
+
+    /***
+     * Parses a table name such as "KQvK" into its piece slots. Returns false if it isn't a supported table.
+     */
+    static bool parseName(const std::string& name, Table& outTable);
+
+    /***
+     * Computes the index of a position in a table, optionally with colors swapped.
+     * Returns false if the position's material doesn't match the table.
+     */
+    static bool computeIndex(const Table& table, Chessboard& board, bool flip, uint32_t& outIndex);
+
+public:
+    /***
+     * Loads every supported table found in a directory. Previously loaded tables are discarded.
+     * Returns the number of tables loaded.
+     */
+    int load(const std::string& dir);
+
+    /***
+     * Returns the largest number of pieces that can be probed, or 0 if no tables are loaded
+     */
+    int getCardinality() { return cardinality; }
+
+    /***
+     * Looks up a position. Positions with only kings, or kings and a single minor piece, are known draws.
+     * Returns false if no loaded table covers the position.
+     */
+    bool probe(Chessboard& board, int& outValue);
+
+    /***
+     * Generates a table by retrograde analysis and writes it to a directory.
+     * Tables reached through captures or promotions must already be loaded or generated.
+     * The new table is added to the loaded tables.
+     */
+    bool generate(const std::string& name, const std::string& dir);
+};
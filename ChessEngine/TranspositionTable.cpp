@@ -0,0 +1,192 @@
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Memory.h"
+#include "TranspositionTable.h"
+
+/***
+ * TABLE FILE FORMAT
+ *   4 bytes  magic "CETT"
+ *   4 bytes  version
+ *   8 bytes  number of entries
+ *   8 bytes  checksum of the entries
+ *   8 bytes  reserved (0)
+ *   the entries, as they are laid out in memory
+ */
+static const char FILE_MAGIC[4] = { 'C', 'E', 'T', 'T' };
+static const uint32_t FILE_VERSION = 1;
+static const size_t FILE_HEADER_SIZE = 32;
+
+// entries are written in chunks of this many bytes, so the whole table is never copied at once
+static const size_t FILE_CHUNK_SIZE = 16 * 1024 * 1024;
+
+TranspositionTable::~TranspositionTable() {
+    Memory::freeLarge(entries);
+}
+
+void TranspositionTable::resize(int sizeMB) {
+    size_t maxEntries = (size_t)sizeMB * 1024 * 1024 / sizeof(TTEntry);
+    size_t newNumEntries = 1;
+    while (newNumEntries * 2 <= maxEntries) {
+        newNumEntries *= 2;
+    }
+    allocate(newNumEntries);
+}
+
+void TranspositionTable::allocate(size_t newNumEntries) {
+    Memory::freeLarge(entries);
+    entries = (TTEntry*)Memory::allocateLarge(newNumEntries * sizeof(TTEntry), largePagesEnabled, largePagesUsed);
+    if (entries == nullptr) {
+        numEntries = 0;
+        throw std::bad_alloc();
+    }
+    numEntries = newNumEntries;
+    mask = numEntries - 1;
+    clear();
+}
+
+void TranspositionTable::clear() {
+    size_t numThreads = std::min<size_t>(std::thread::hardware_concurrency(), numEntries * sizeof(TTEntry) / PARALLEL_CLEAR_BYTES);
+    if (numThreads <= 1) {
+        std::fill(entries, entries + numEntries, TTEntry());
+        return;
+    }
+
+    // numEntries is a power of 2 larger than numThreads, so the slices are close to equal
+    size_t sliceSize = (numEntries + numThreads - 1) / numThreads;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; t++) {
+        threads.push_back(std::thread([this, t, sliceSize]() {
+            Memory::bindThread((int)t);
+            size_t start = std::min(numEntries, t * sliceSize);
+            size_t end = std::min(numEntries, start + sliceSize);
+            std::fill(entries + start, entries + end, TTEntry());
+        }));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void TranspositionTable::setLargePages(bool enabled) {
+    largePagesEnabled = enabled;
+    allocate(numEntries);
+}
+
+uint64_t TranspositionTable::checksum(uint64_t hash, const TTEntry* data, size_t count) {
+    // FNV-1a over 64 bit words instead of bytes, fast enough to not slow down saving or loading
+    const uint64_t* words = (const uint64_t*)data;
+    size_t numWords = count * sizeof(TTEntry) / sizeof(uint64_t);
+    for (size_t i = 0; i < numWords; i++) {
+        hash = (hash ^ words[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+bool TranspositionTable::save(const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+
+    // the checksum is only known after writing the entries, so the header is written again at the end
+    char header[FILE_HEADER_SIZE] = { };
+    out.write(header, FILE_HEADER_SIZE);
+    uint64_t hash = 0xCBF29CE484222325ull;
+    size_t chunkEntries = FILE_CHUNK_SIZE / sizeof(TTEntry);
+    for (size_t start = 0; start < numEntries; start += chunkEntries) {
+        size_t count = std::min(chunkEntries, numEntries - start);
+        hash = checksum(hash, entries + start, count);
+        out.write((const char*)(entries + start), count * sizeof(TTEntry));
+    }
+
+    uint64_t count = numEntries;
+    std::memcpy(header, FILE_MAGIC, 4);
+    std::memcpy(header + 4, &FILE_VERSION, sizeof(FILE_VERSION));
+    std::memcpy(header + 8, &count, sizeof(count));
+    std::memcpy(header + 16, &hash, sizeof(hash));
+    out.seekp(0);
+    out.write(header, FILE_HEADER_SIZE);
+    return (bool)out;
+}
+
+bool TranspositionTable::load(const std::string& path) {
+    MappedFile file(path, true);
+    if (!file.isOpen() || file.size() < FILE_HEADER_SIZE) {
+        return false;
+    }
+    const char* data = (const char*)file.getData();
+    uint32_t version;
+    uint64_t count, hash;
+    std::memcpy(&version, data + 4, sizeof(version));
+    std::memcpy(&count, data + 8, sizeof(count));
+    std::memcpy(&hash, data + 16, sizeof(hash));
+    if (std::memcmp(data, FILE_MAGIC, 4) != 0 || version != FILE_VERSION || count == 0 || (count & (count - 1)) != 0 ||
+        file.size() != FILE_HEADER_SIZE + count * sizeof(TTEntry)) {
+        return false;
+    }
+
+    // checked before touching the table, so a corrupted file doesn't replace good entries
+    const TTEntry* saved = (const TTEntry*)(data + FILE_HEADER_SIZE);
+    if (checksum(0xCBF29CE484222325ull, saved, count) != hash) {
+        return false;
+    }
+
+    if (count != numEntries) {
+        allocate(count);
+    }
+    std::memcpy(entries, saved, count * sizeof(TTEntry));
+    return true;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& outEntry) {
+    TTEntry& entry = entries[key & mask];
+    if (entry.bound == BOUND_NONE || entry.key != key) {
+        return false;
+    }
+    outEntry = entry;
+    return true;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, int score, TTBound bound, Move move) {
+    TTEntry& entry = entries[key & mask];
+    if (entry.key == key && entry.bound != BOUND_NONE && depth < entry.depth) {
+        return;
+    }
+    entry.key = key;
+    entry.score = score;
+    entry.move = packMove(move);
+    entry.depth = (int8_t)depth;
+    entry.bound = bound;
+}
+
+int TranspositionTable::hashfull() {
+    size_t sampleSize = std::min<size_t>(1000, numEntries);
+    int used = 0;
+    for (size_t i = 0; i < sampleSize; i++) {
+        if (entries[i].bound != BOUND_NONE) {
+            used++;
+        }
+    }
+    return (int)(used * 1000 / sampleSize);
+}
+
+uint16_t TranspositionTable::packMove(Move m) {
+    if (m.from == Square::SQUARE_NONE) {
+        return 0;
+    }
+    return (uint16_t)(m.from | (m.to << 6) | (m.promotion << 12));
+}
+
+Move TranspositionTable::unpackMove(uint16_t packed) {
+    if (packed == 0) {
+        return { Square::SQUARE_NONE, Square::SQUARE_NONE };
+    }
+    return { (Square)(packed & 63), (Square)((packed >> 6) & 63), (Piece)(packed >> 12) };
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <xmmintrin.h>
+
+#include "Chessboard.h"
+
+/***
+ * How a stored score relates to the true score of the position
+ *   BOUND_EXACT - the score is exact
+ *   BOUND_LOWER - the true score is at least the stored score (a move caused a cutoff)
+ *   BOUND_UPPER - the true score is at most the stored score (every move was worse than the window)
+ */
+enum TTBound : uint8_t {
+    BOUND_NONE,
+    BOUND_UPPER,
+    BOUND_LOWER,
+    BOUND_EXACT
+};
+
+struct TTEntry {
+    uint64_t key;
+    int32_t score;
+    uint16_t move;  // packed with TranspositionTable::packMove
+    int8_t depth;
+    uint8_t bound;
+};
+
+/***
+ * Hash table of search results indexed by Zobrist hash. The table is kept between searches so
+ * that later searches (ex: after pondering, or on the next move) start with the results of earlier ones.
+ *
+ * Every probe is a random access into a table much larger than the caches, so the table is allocated
+ * with large pages when possible (see Memory.h) to avoid a TLB miss on top of the cache miss.
+ */
+class TranspositionTable
+{
+private:
+    // tables at least this large are cleared by several threads
+    static const size_t PARALLEL_CLEAR_BYTES = 64 * 1024 * 1024;
+
+    TTEntry* entries = nullptr;
+    size_t numEntries = 0;
+    uint64_t mask = 0; // number of entries - 1, the number of entries is a power of 2
+    bool largePagesEnabled = true;
+    bool largePagesUsed = false;
+
+    /***
+     * Reallocates the table with a number of entries (a power of 2). Clears all entries.
+     */
+    void allocate(size_t newNumEntries);
+
+    /***
+     * Continues a checksum of the table file with more entries
+     */
+    static uint64_t checksum(uint64_t hash, const TTEntry* data, size_t count);
+
+public:
+    static const int DEFAULT_SIZE_MB = 16;
+
+    TranspositionTable(int sizeMB = DEFAULT_SIZE_MB) { resize(sizeMB); }
+    ~TranspositionTable();
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    /***
+     * Reallocates the table with the largest power of 2 number of entries that fits in sizeMB. Clears all entries.
+     */
+    void resize(int sizeMB);
+
+    /***
+     * Removes all entries. Large tables are cleared in slices by threads spread over the machine
+     * (see Memory::bindThread), so each slice is placed on the NUMA node of the thread that cleared it.
+     */
+    void clear();
+
+    /***
+     * Sets whether the table should use large pages and reallocates it. Clears all entries.
+     */
+    void setLargePages(bool enabled);
+
+    /***
+     * Returns true if the table is currently backed by large pages
+     */
+    bool usesLargePages() { return largePagesUsed; }
+
+    /***
+     * Looks up a position. Returns false if it isn't stored.
+     */
+    bool probe(uint64_t key, TTEntry& outEntry);
+
+    /***
+     * Starts loading the entry of a position into the cache without waiting for it
+     */
+    void prefetch(uint64_t key) const { _mm_prefetch((const char*)&entries[key & mask], _MM_HINT_T0); }
+
+    /***
+     * Stores the result of searching a position. An entry for a different position is always replaced,
+     * an entry for the same position only if the new search was at least as deep.
+     */
+    void store(uint64_t key, int depth, int score, TTBound bound, Move move);
+
+    /***
+     * Returns the number of used entries per thousand, sampled from the start of the table
+     */
+    int hashfull();
+
+    /***
+     * Writes every entry to a file so that a later session (ex: analysis of the same position after a
+     * restart) can continue from this one. Returns false if the file couldn't be written.
+     */
+    bool save(const std::string& path);
+
+    /***
+     * Replaces the table with one written by save, resizing it to the size that was saved.
+     * Returns false and leaves the table unchanged if the file is missing, from another version, or corrupted.
+     */
+    bool load(const std::string& path);
+
+    /***
+     * Returns the size of the table in MB
+     */
+    size_t sizeMB() { return numEntries * sizeof(TTEntry) / (1024 * 1024); }
+
+    /***
+     * Moves are stored in 16 bits: from (6 bits), to (6 bits), promotion piece (4 bits)
+     */
+    static uint16_t packMove(Move m);
+    static Move unpackMove(uint16_t packed);
+};
@@ -0,0 +1,223 @@
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "Bitboard.h"
+#include "TunedParams.h"
+#include "Tuner.h"
+
+Tuner::Tuner(TunerOptions options) : options(options) {
+    if (this->options.numThreads < 1) {
+        this->options.numThreads = 1;
+    }
+
+    // start from the parameters the engine is currently compiled with
+    params.resize(NUM_PARAMS);
+    for (int p = 0; p < NUM_MATERIAL_PARAMS; p++) {
+        params[p] = TunedParams::PIECE_VALUES[p];
+    }
+    for (int p = 0; p < 6; p++) {
+        for (int sq = 0; sq < 64; sq++) {
+            params[PSQT_OFFSET + p * 64 + sq] = TunedParams::PSQT[p][sq];
+        }
+    }
+}
+
+void Tuner::extractFeatures(const PackedPosition& p, std::vector<Feature>& outFeatures) {
+    int material[NUM_MATERIAL_PARAMS] = { };
+
+    Bitboard occupancy = p.occupancy;
+    int pieceIdx = 0;
+    while (occupancy && pieceIdx < 32) {
+        int sq = Bitboards::popLSB(occupancy);
+        int boardIdx = PackedPositions::getNibble(p, pieceIdx);
+        pieceIdx++;
+
+        // board index = Player + Piece where white = 0, black = 6
+        bool isWhite = boardIdx < 6;
+        int piece = isWhite ? boardIdx : boardIdx - 6;
+        if (piece < NUM_MATERIAL_PARAMS) {
+            material[piece] += isWhite ? 1 : -1;
+        }
+        int psqtSquare = isWhite ? sq : sq ^ 56; // mirror rank for black
+        outFeatures.push_back({ PSQT_OFFSET + piece * 64 + psqtSquare, isWhite ? 1 : -1 });
+    }
+
+    for (int piece = 0; piece < NUM_MATERIAL_PARAMS; piece++) {
+        if (material[piece] != 0) {
+            outFeatures.push_back({ piece, material[piece] });
+        }
+    }
+}
+
+void Tuner::computeLossRange(size_t begin, size_t end, double& outLoss, std::vector<double>* outGradient) {
+    std::vector<Feature> features[BATCH_SIZE];
+    float evals[BATCH_SIZE];
+    float errors[BATCH_SIZE];
+    const float scale = (float)(scalingK / 400.0);
+
+    double loss = 0;
+    for (size_t batchStart = begin; batchStart < end; batchStart += BATCH_SIZE) {
+        int batchSize = (int)(end - batchStart < BATCH_SIZE ? end - batchStart : BATCH_SIZE);
+
+        for (int i = 0; i < batchSize; i++) {
+            features[i].clear();
+            extractFeatures(positions[batchStart + i], features[i]);
+            double eval = 0;
+            for (Feature& f : features[i]) {
+                eval += params[f.index] * f.coefficient;
+            }
+            evals[i] = (float)eval;
+        }
+
+        // sigmoid and error terms over contiguous arrays
+        const float* batchTargets = &targets[batchStart];
+        for (int i = 0; i < batchSize; i++) {
+            float s = 1.0f / (1.0f + std::exp(-scale * evals[i]));
+            float diff = s - batchTargets[i];
+            loss += diff * diff;
+            // d(diff^2)/d(eval) = 2 * diff * s * (1 - s) * scale
+            errors[i] = 2.0f * diff * s * (1.0f - s) * scale;
+        }
+
+        if (outGradient != nullptr) {
+            for (int i = 0; i < batchSize; i++) {
+                for (Feature& f : features[i]) {
+                    (*outGradient)[f.index] += errors[i] * f.coefficient;
+                }
+            }
+        }
+    }
+    outLoss = loss;
+}
+
+double Tuner::computeLoss(std::vector<double>* outGradient) {
+    int numThreads = options.numThreads;
+    std::vector<double> threadLosses(numThreads);
+    std::vector<std::vector<double>> threadGradients(numThreads, std::vector<double>(outGradient ? NUM_PARAMS : 0));
+    std::vector<std::thread> threads;
+
+    size_t chunkSize = (positions.size() + numThreads - 1) / numThreads;
+    for (int t = 0; t < numThreads; t++) {
+        size_t begin = t * chunkSize < positions.size() ? t * chunkSize : positions.size();
+        size_t end = begin + chunkSize < positions.size() ? begin + chunkSize : positions.size();
+        threads.push_back(std::thread(&Tuner::computeLossRange, this, begin, end,
+            std::ref(threadLosses[t]), outGradient ? &threadGradients[t] : nullptr));
+    }
+
+    double loss = 0;
+    for (int t = 0; t < numThreads; t++) {
+        threads[t].join();
+        loss += threadLosses[t];
+        if (outGradient != nullptr) {
+            for (int i = 0; i < NUM_PARAMS; i++) {
+                (*outGradient)[i] += threadGradients[t][i] / positions.size();
+            }
+        }
+    }
+    return loss / positions.size();
+}
+
+void Tuner::fitScalingConstant() {
+    // the loss is smooth in K, so narrow down a range around the minimum
+    double low = 0.1;
+    double high = 3.0;
+    for (int iteration = 0; iteration < 20; iteration++) {
+        double mid1 = low + (high - low) / 3;
+        double mid2 = high - (high - low) / 3;
+        scalingK = mid1;
+        double loss1 = computeLoss(nullptr);
+        scalingK = mid2;
+        double loss2 = computeLoss(nullptr);
+        if (loss1 < loss2) {
+            high = mid2;
+        }
+        else {
+            low = mid1;
+        }
+    }
+    scalingK = (low + high) / 2;
+}
+
+void Tuner::writeHeader() {
+    const char* pieceNames[] = { "PAWN", "KNIGHT", "BISHOP", "ROOK", "QUEEN", "KING" };
+
+    std::ofstream out(options.outputPath);
+    out << "#pragma once\n\n";
+    out << "/***\n";
+    out << " * Evaluation parameters. This file is generated by \"ChessEngine tune\", do not edit it by hand.\n";
+    out << " * Piece square tables are indexed by square from white's perspective (A1 = 0).\n";
+    out << " */\n";
+    out << "namespace TunedParams {\n";
+    out << "    constexpr int PIECE_VALUES[5] = { ";
+    for (int p = 0; p < NUM_MATERIAL_PARAMS; p++) {
+        out << std::lround(params[p]) << (p + 1 < NUM_MATERIAL_PARAMS ? ", " : " };\n\n");
+    }
+    out << "    constexpr int PSQT[6][64] = {\n";
+    for (int p = 0; p < 6; p++) {
+        out << "        { // " << pieceNames[p] << "\n";
+        for (int rank = 0; rank < 8; rank++) {
+            out << "            ";
+            for (int file = 0; file < 8; file++) {
+                out << std::lround(params[PSQT_OFFSET + p * 64 + rank * 8 + file]);
+                bool isLast = rank == 7 && file == 7;
+                out << (isLast ? "" : (file == 7 ? "," : ", "));
+            }
+            out << "\n";
+        }
+        out << (p + 1 < 6 ? "        },\n" : "        }\n");
+    }
+    out << "    };\n";
+    out << "}\n";
+}
+
+void Tuner::run() {
+    {
+        PackedPositionReader reader(options.inputPath);
+        if (!reader.isOpen()) {
+            std::cerr << "could not open " << options.inputPath << std::endl;
+            return;
+        }
+        positions.assign(reader.begin(), reader.end());
+    }
+    if (positions.empty()) {
+        std::cerr << "no positions to tune on" << std::endl;
+        return;
+    }
+
+    // labels: game result mapped to 0 / 0.5 / 1, optionally blended with the search score
+    targets.resize(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        double result = (positions[i].result + 1) / 2.0;
+        double scoreProbability = 1.0 / (1.0 + std::pow(10.0, -positions[i].score / 400.0));
+        targets[i] = (float)(options.resultWeight * result + (1 - options.resultWeight) * scoreProbability);
+    }
+
+    fitScalingConstant();
+    std::cerr << "positions " << positions.size() << " K " << scalingK << " initial loss " << computeLoss(nullptr) << std::endl;
+
+    // Adam
+    const double beta1 = 0.9;
+    const double beta2 = 0.999;
+    const double epsilon = 1e-8;
+    std::vector<double> momentum(NUM_PARAMS);
+    std::vector<double> velocity(NUM_PARAMS);
+    for (int epoch = 1; epoch <= options.epochs; epoch++) {
+        std::vector<double> gradient(NUM_PARAMS);
+        double loss = computeLoss(&gradient);
+        for (int i = 0; i < NUM_PARAMS; i++) {
+            momentum[i] = beta1 * momentum[i] + (1 - beta1) * gradient[i];
+            velocity[i] = beta2 * velocity[i] + (1 - beta2) * gradient[i] * gradient[i];
+            double correctedMomentum = momentum[i] / (1 - std::pow(beta1, epoch));
+            double correctedVelocity = velocity[i] / (1 - std::pow(beta2, epoch));
+            params[i] -= options.learningRate * correctedMomentum / (std::sqrt(correctedVelocity) + epsilon);
+        }
+        if (epoch % 50 == 0 || epoch == options.epochs) {
+            std::cerr << "epoch " << epoch << " loss " << loss << std::endl;
+        }
+    }
+
+    writeHeader();
+}
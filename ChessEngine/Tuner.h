@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "PackedPosition.h"
+
+/***
+ * Settings for a tuning run
+ */
+struct TunerOptions {
+    std::string inputPath;                   // packed positions labeled with a score and result
+    std::string outputPath = "TunedParams.h";
+    int numThreads = 1;
+    int epochs = 500;
+    double learningRate = 1.0;               // Adam step size, in centipawns
+    double resultWeight = 1.0;               // target = resultWeight * result + (1 - resultWeight) * sigmoid(score)
+};
+
+/***
+ * Texel style tuner for the evaluation parameters.
+ *
+ * The evaluation is linear in its parameters: eval = sum(weight_i * feature_i), where the features are
+ *   - material: (# white pieces - # black pieces) for each piece type except the king
+ *   - piece square tables: +1 for each white piece on a square, -1 for each black piece on the
+ *     vertically mirrored square, so both colors share one table written from white's perspective
+ *
+ * Each position is mapped to a win probability sigmoid(K * eval / 400) and the mean squared error
+ * against the labels is minimized with Adam. Positions are kept in their 32 byte packed form and
+ * features are decoded on the fly, so millions of positions fit in memory.
+ */
+class Tuner
+{
+public:
+    static const int NUM_MATERIAL_PARAMS = 5;
+    static const int PSQT_OFFSET = NUM_MATERIAL_PARAMS;
+    static const int NUM_PARAMS = NUM_MATERIAL_PARAMS + 6 * 64;
+
+    /***
+     * A nonzero feature of a position
+     */
+    struct Feature {
+        int index;
+        int coefficient;
+    };
+
+private:
+    TunerOptions options;
+
+    std::vector<PackedPosition> positions;
+    std::vector<float> targets;
+
+    std::vector<double> params;
+    double scalingK = 1.0;
+
+    /***
+     * Number of positions whose evals are computed together before applying the sigmoid,
+     * so the sigmoid loop runs over contiguous arrays and can be vectorized
+     */
+    static const int BATCH_SIZE = 256;
+
+    /***
+     * Returns the mean loss over all positions and, if outGradient is given,
+     * stores the gradient of the loss with respect to each parameter in it
+     */
+    double computeLoss(std::vector<double>* outGradient);
+
+    /***
+     * Accumulates the loss and gradient for positions [begin, end)
+     */
+    void computeLossRange(size_t begin, size_t end, double& outLoss, std::vector<double>* outGradient);
+
+    /***
+     * Finds the scaling constant K that best fits the labels with the initial parameters
+     */
+    void fitScalingConstant();
+
+    void writeHeader();
+
+public:
+    Tuner(TunerOptions options);
+
+    /***
+     * Appends the nonzero features of a packed position to outFeatures
+     */
+    static void extractFeatures(const PackedPosition& p, std::vector<Feature>& outFeatures);
+
+    /***
+     * Loads the positions, tunes the parameters and writes them as a C++ header
+     */
+    void run();
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+/***
+ * Zobrist hashing: a position's hash is the XOR of a random number for each of its features
+ * (piece on square, castling rights, en passant file, side to move), so a move only has to XOR
+ * in and out the features it changes.
+ *
+ * The numbers are generated at compile time so they are available before any board is constructed.
+ */
+namespace Zobrist {
+    struct Keys {
+        uint64_t pieceSquare[12][64]; // indexed by board index (Piece + Player) and square
+        uint64_t castle[4];           // white kingside, white queenside, black kingside, black queenside
+        uint64_t enPassantFile[8];
+        uint64_t blackToMove;
+    };
+
+    constexpr uint64_t splitMix64(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    constexpr Keys generateKeys() {
+        Keys keys = { };
+        uint64_t state = 0x5A0B1C2D3E4F6071ull;
+        for (int p = 0; p < 12; p++) {
+            for (int sq = 0; sq < 64; sq++) {
+                keys.pieceSquare[p][sq] = splitMix64(state);
+            }
+        }
+        for (int i = 0; i < 4; i++) {
+            keys.castle[i] = splitMix64(state);
+        }
+        for (int i = 0; i < 8; i++) {
+            keys.enPassantFile[i] = splitMix64(state);
+        }
+        keys.blackToMove = splitMix64(state);
+        return keys;
+    }
+
+    inline constexpr Keys KEYS = generateKeys();
+}
@@ -1,19 +1,295 @@
 
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <string>
 
+#include "BatchAnalyzer.h"
 #include "ChessEngine.h"
+#include "MateSolver.h"
+#include "Memory.h"
+#include "OpeningBook.h"
+#include "PackedPosition.h"
+#include "SelfPlay.h"
+#include "Tablebase.h"
+#include "Tuner.h"
 
-int main()
+/***
+ * Parses the "-flag value" pairs that follow a command
+ */
+std::map<std::string, std::string> parseFlags(int argc, char* argv[]) {
+    std::map<std::string, std::string> flags;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        flags[argv[i]] = argv[i + 1];
+    }
+    return flags;
+}
+
+void runBatch(std::map<std::string, std::string>& flags) {
+    BatchOptions options;
+    options.inputPath = flags["-i"];
+    options.outputPath = flags["-o"];
+    if (flags.count("-t")) {
+        options.numThreads = std::stoi(flags["-t"]);
+    }
+    if (flags.count("-d")) {
+        options.depth = std::stoi(flags["-d"]);
+    }
+    options.jsonl = flags["-f"] == "jsonl";
+    BatchAnalyzer(options).run();
+}
+
+void runSelfPlay(std::map<std::string, std::string>& flags) {
+    SelfPlayOptions options;
+    options.outputPath = flags["-o"];
+    if (flags.count("-t")) {
+        options.numThreads = std::stoi(flags["-t"]);
+    }
+    if (flags.count("-d")) {
+        options.depth = std::stoi(flags["-d"]);
+    }
+    if (flags.count("-n")) {
+        options.numPositions = std::stoull(flags["-n"]);
+    }
+    if (flags.count("-r")) {
+        options.randomPlies = std::stoi(flags["-r"]);
+    }
+    if (options.outputPath.empty()) {
+        std::cerr << "an output file must be given with -o" << std::endl;
+        return;
+    }
+    SelfPlay(options).run();
+}
+
+void runTune(std::map<std::string, std::string>& flags) {
+    TunerOptions options;
+    options.inputPath = flags["-i"];
+    if (flags.count("-o")) {
+        options.outputPath = flags["-o"];
+    }
+    if (flags.count("-t")) {
+        options.numThreads = std::stoi(flags["-t"]);
+    }
+    if (flags.count("-e")) {
+        options.epochs = std::stoi(flags["-e"]);
+    }
+    if (flags.count("-l")) {
+        options.learningRate = std::stod(flags["-l"]);
+    }
+    if (flags.count("-w")) {
+        options.resultWeight = std::stod(flags["-w"]);
+    }
+    Tuner(options).run();
+}
+
+/***
+ * Generates every supported tablebase into a directory
+ */
+void runTablebaseGeneration(std::map<std::string, std::string>& flags) {
+    std::string dir = flags.count("-o") ? flags["-o"] : ".";
+    Bitboards::initPieceMoveBoards();
+    Tablebases tablebases;
+    for (const char* name : Tablebases::SUPPORTED_TABLES) {
+        std::cerr << "generating " << name << std::endl;
+        if (!tablebases.generate(name, dir)) {
+            std::cerr << "could not generate " << name << std::endl;
+            return;
+        }
+    }
+}
+
+/***
+ * Builds an opening book from a file of games written as UCI moves
+ */
+void runMakeBook(std::map<std::string, std::string>& flags) {
+    std::ifstream in(flags["-i"]);
+    if (!in) {
+        std::cerr << "could not open input file" << std::endl;
+        return;
+    }
+    int maxPly = flags.count("-p") ? std::stoi(flags["-p"]) : 16;
+    Bitboards::initPieceMoveBoards();
+    int numEntries = OpeningBook::build(in, flags["-o"], maxPly);
+    if (numEntries < 0) {
+        std::cerr << "could not write book" << std::endl;
+        return;
+    }
+    std::cerr << "wrote " << numEntries << " entries" << std::endl;
+}
+
+/***
+ * Verifies mate puzzles. Each EPD line gives the number of moves to mate with a "dm" operation
+ * (ex: dm 2;), lines without one use the -m flag.
+ */
+void runMateSolver(std::map<std::string, std::string>& flags) {
+    std::ifstream inFile;
+    std::istream* in = &std::cin;
+    if (!flags["-i"].empty()) {
+        inFile.open(flags["-i"]);
+        if (!inFile) {
+            std::cerr << "could not open " << flags["-i"] << std::endl;
+            return;
+        }
+        in = &inFile;
+    }
+    std::ofstream outFile;
+    std::ostream* out = &std::cout;
+    if (!flags["-o"].empty()) {
+        outFile.open(flags["-o"]);
+        out = &outFile;
+    }
+    int defaultMoves = flags.count("-m") ? std::stoi(flags["-m"]) : 3;
+    int numThreads = flags.count("-t") ? std::stoi(flags["-t"]) : 1;
+    uint64_t maxNodes = flags.count("-n") ? std::stoull(flags["-n"]) : 0;
+    int hashMB = flags.count("-h") ? std::stoi(flags["-h"]) : MateSolver::DEFAULT_HASH_MB;
+
+    Bitboards::initPieceMoveBoards();
+    MateSolver solver(hashMB);
+    *out << "index,id,fen,mate,result,pv,nodes\n";
+
+    std::string line;
+    uint64_t index = 0;
+    while (std::getline(*in, line)) {
+        std::string id;
+        std::string fen = BatchAnalyzer::lineToFEN(line, id);
+        index++;
+        if (fen.empty()) {
+            continue;
+        }
+        int moves = defaultMoves;
+        size_t dm = line.find(" dm ");
+        if (dm != std::string::npos) {
+            moves = std::atoi(line.c_str() + dm + 4);
+        }
+
+        MateSolution solution = solver.solve(Chessboard(fen), moves, numThreads, maxNodes);
+        const char* result = solution.result == ProofResult::PROVEN ? "proven" :
+            solution.result == ProofResult::DISPROVEN ? "disproven" : "unknown";
+        std::string pv = "";
+        for (Move& m : solution.pv) {
+            pv += (pv.empty() ? "" : " ") + Moves::toString(m);
+        }
+        *out << index - 1 << "," << BatchAnalyzer::quote(id, false) << "," << fen << "," << moves << "," << result << "," << pv << ","
+             << solution.nodes << std::endl;
+    }
+}
+
+/***
+ * Converts a file of EPD/FEN lines to packed positions
+ */
+void runPack(std::map<std::string, std::string>& flags) {
+    std::ifstream in(flags["-i"]);
+    PackedPositionWriter writer(flags["-o"]);
+    if (!in || !writer.isOpen()) {
+        std::cerr << "could not open input or output file" << std::endl;
+        return;
+    }
+    Bitboards::initPieceMoveBoards();
+    std::string line;
+    std::string id;
+    while (std::getline(in, line)) {
+        std::string fen = BatchAnalyzer::lineToFEN(line, id);
+        if (!fen.empty()) {
+            writer.write(Chessboard(fen).toPacked());
+        }
+    }
+}
+
+/***
+ * Converts a file of packed positions to FEN lines
+ */
+void runUnpack(std::map<std::string, std::string>& flags) {
+    PackedPositionReader reader(flags["-i"]);
+    if (!reader.isOpen()) {
+        std::cerr << "could not open " << flags["-i"] << std::endl;
+        return;
+    }
+    std::ofstream outFile;
+    std::ostream* out = &std::cout;
+    if (!flags["-o"].empty()) {
+        outFile.open(flags["-o"]);
+        out = &outFile;
+    }
+    Bitboards::initPieceMoveBoards();
+    for (const PackedPosition& p : reader) {
+        *out << Chessboard(p).toFEN() << "\n";
+    }
+}
+
+/***
+ * Usage:
+ *   ChessEngine                    communicate using UCI through stdin/stdout
+ *   ChessEngine batch [options]    analyze a stream of EPD/FEN positions
+ *     -i <file>    input file (default: stdin)
+ *     -o <file>    output file (default: stdout)
+ *     -t <n>       number of threads
+ *     -d <n>       search depth
+ *     -f csv|jsonl output format
+ *   ChessEngine selfplay -o <packed file> [options]    generate training positions
+ *     -t <n>       number of threads
+ *     -d <n>       search depth
+ *     -n <n>       number of positions to generate
+ *     -r <n>       number of random moves at the start of each game
+ *   ChessEngine tune -i <packed file> [options]        tune evaluation parameters
+ *     -o <file>    generated header (default: TunedParams.h)
+ *     -t <n>       number of threads
+ *     -e <n>       number of epochs
+ *     -l <x>       learning rate
+ *     -w <x>       weight of the game result vs the search score in the training target
+ *   ChessEngine tbgen [-o <dir>]                       generate endgame tablebases
+ *   ChessEngine makebook -i <games file> -o <book file> [-p <max ply>]
+ *                                                      build an opening book from games of UCI moves
+ *   ChessEngine mate [options]                         prove forced mates in EPD/FEN positions
+ *     -i <file>    input file (default: stdin)
+ *     -o <file>    output file (default: stdout)
+ *     -m <n>       moves to mate for lines without a "dm" operation (default: 3)
+ *     -t <n>       number of threads
+ *     -n <n>       maximum number of nodes per position (default: no limit)
+ *     -h <n>       node store size in MB
+ *   ChessEngine pack -i <epd/fen file> -o <packed file>
+ *   ChessEngine unpack -i <packed file> [-o <fen file>]
+ */
+int main(int argc, char* argv[])
 {
+    if (argc > 1) {
+        std::string command = argv[1];
+        std::map<std::string, std::string> flags = parseFlags(argc, argv);
+        if (command == "batch") {
+            runBatch(flags);
+            return 0;
+        }
+        if (command == "selfplay") {
+            runSelfPlay(flags);
+            return 0;
+        }
+        if (command == "tune") {
+            runTune(flags);
+            return 0;
+        }
+        if (command == "tbgen") {
+            runTablebaseGeneration(flags);
+            return 0;
+        }
+        if (command == "makebook") {
+            runMakeBook(flags);
+            return 0;
+        }
+        if (command == "mate") {
+            runMateSolver(flags);
+            return 0;
+        }
+        if (command == "pack") {
+            runPack(flags);
+            return 0;
+        }
+        if (command == "unpack") {
+            runUnpack(flags);
+            return 0;
+        }
+    }
+
+    // searches run on the first NUMA node, so tables small enough to be cleared by this thread are placed there too
+    Memory::bindThread(0);
     ChessEngine engine = ChessEngine();
     engine.startUCI();
-    /*
-    engine.board = Chessboard();
-
-    for (int i = 0; i < 200; i++) {
-        Move m = engine.search(5);
-        engine.board.makeMove(m);
-        std::cout << Moves::toString(m) << std::endl;
-    }
-    */
 }
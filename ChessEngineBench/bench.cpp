@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "../ChessEngine/Chessboard.h"
+#include "../ChessEngine/TranspositionTable.h"
+
+/***
+ * MICROBENCHMARKS:
+ * Each benchmark performs one operation per iteration on a position from the corpus below,
+ * cycling through the corpus so no single position dominates. The reported time is therefore
+ * the cost of a single operation (ns/op). Benchmarks that produce or consume moves also report
+ * a moves/s rate.
+ *
+ * Positions sourced from: https://www.chessprogramming.org/Perft_Results
+ */
+static const std::vector<std::string> CORPUS = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "rnbqkbnr/pp1ppppp/8/1PpP4/8/8/P1P1PPPP/RNBQKBNR w KQkq c6 0 1",
+    "8/3k4/8/8/3q4/8/4K3/8 w - - 0 1",
+};
+
+/***
+ * Returns the corpus loaded into boards. Parsing is done once so that only the
+ * primitive under test is measured.
+ */
+static std::vector<Chessboard> loadCorpus() {
+    Bitboards::initPieceMoveBoards();
+    std::vector<Chessboard> boards;
+    for (const std::string& fen : CORPUS) {
+        boards.push_back(Chessboard(fen));
+    }
+    return boards;
+}
+
+static void BM_ParseFEN(benchmark::State& state) {
+    Bitboards::initPieceMoveBoards();
+    size_t idx = 0;
+    for (auto _ : state) {
+        Chessboard c = Chessboard(CORPUS[idx]);
+        benchmark::DoNotOptimize(c);
+        idx = (idx + 1) % CORPUS.size();
+    }
+}
+BENCHMARK(BM_ParseFEN);
+
+static void BM_ParsePacked(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    std::vector<PackedPosition> packed;
+    for (Chessboard& c : boards) {
+        packed.push_back(c.toPacked());
+    }
+    size_t idx = 0;
+    for (auto _ : state) {
+        Chessboard c = Chessboard(packed[idx]);
+        benchmark::DoNotOptimize(c);
+        idx = (idx + 1) % packed.size();
+    }
+}
+BENCHMARK(BM_ParsePacked);
+
+static void BM_ToFEN(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    size_t idx = 0;
+    for (auto _ : state) {
+        std::string fen = boards[idx].toFEN();
+        benchmark::DoNotOptimize(fen);
+        idx = (idx + 1) % boards.size();
+    }
+}
+BENCHMARK(BM_ToFEN);
+
+static void BM_GenerateAllPseudolegalMoves(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    size_t idx = 0;
+    int64_t numMoves = 0;
+    for (auto _ : state) {
+        std::vector<Move> moves = boards[idx].generateAllPseudolegalMoves();
+        numMoves += moves.size();
+        benchmark::DoNotOptimize(moves.data());
+        idx = (idx + 1) % boards.size();
+    }
+    state.counters["moves/s"] = benchmark::Counter((double)numMoves, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_GenerateAllPseudolegalMoves);
+
+static void BM_GenerateAllLegalMoves(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    size_t idx = 0;
+    int64_t numMoves = 0;
+    for (auto _ : state) {
+        std::vector<Move> moves = boards[idx].generateAllLegalMoves();
+        numMoves += moves.size();
+        benchmark::DoNotOptimize(moves.data());
+        idx = (idx + 1) % boards.size();
+    }
+    state.counters["moves/s"] = benchmark::Counter((double)numMoves, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_GenerateAllLegalMoves);
+
+static void BM_MakeUndoMove(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    std::vector<std::vector<Move>> movesPerBoard;
+    for (Chessboard& c : boards) {
+        movesPerBoard.push_back(c.generateAllLegalMoves());
+    }
+
+    // one iteration = one makeMove/undoMove pair
+    size_t boardIdx = 0;
+    size_t moveIdx = 0;
+    for (auto _ : state) {
+        Chessboard& c = boards[boardIdx];
+        MoveUndoInfo undoInfo = c.makeMove(movesPerBoard[boardIdx][moveIdx]);
+        c.undoMove(undoInfo);
+        benchmark::ClobberMemory();
+
+        moveIdx++;
+        if (moveIdx == movesPerBoard[boardIdx].size()) {
+            moveIdx = 0;
+            boardIdx = (boardIdx + 1) % boards.size();
+        }
+    }
+    state.counters["moves/s"] = benchmark::Counter((double)state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_MakeUndoMove);
+
+static void BM_MakeUndoMoveInPlace(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    std::vector<std::vector<Move>> movesPerBoard;
+    for (Chessboard& c : boards) {
+        movesPerBoard.push_back(c.generateAllLegalMoves());
+    }
+
+    // one iteration = one makeMoveInPlace/undoMoveInPlace pair
+    size_t boardIdx = 0;
+    size_t moveIdx = 0;
+    for (auto _ : state) {
+        Chessboard& c = boards[boardIdx];
+        MoveUndoInfo undoInfo = c.makeMoveInPlace(movesPerBoard[boardIdx][moveIdx]);
+        c.undoMoveInPlace(undoInfo);
+        benchmark::ClobberMemory();
+
+        moveIdx++;
+        if (moveIdx == movesPerBoard[boardIdx].size()) {
+            moveIdx = 0;
+            boardIdx = (boardIdx + 1) % boards.size();
+        }
+    }
+    state.counters["moves/s"] = benchmark::Counter((double)state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_MakeUndoMoveInPlace);
+
+/***
+ * COPY-MAKE VS MAKE/UNMAKE:
+ * The same workloads run with either way of making moves, so the two can be compared directly.
+ * Moves come from generateAllLegalMoves, which filters pseudolegal moves with isLegal using the pins and
+ * checkers stored for the position, so no move has to be made to test its legality.
+ *   Perft  - counts the leaves of a fixed depth tree (state.range(0) plies)
+ *   Search - fixed depth alpha beta on material, which undoes moves after cutoffs at every depth
+ */
+struct CopyMake {
+    static MoveUndoInfo make(Chessboard& c, Move m) { return c.makeMove(m); }
+    static void undo(Chessboard& c, MoveUndoInfo m) { c.undoMove(m); }
+};
+
+struct MakeUnmake {
+    static MoveUndoInfo make(Chessboard& c, Move m) { return c.makeMoveInPlace(m); }
+    static void undo(Chessboard& c, MoveUndoInfo m) { c.undoMoveInPlace(m); }
+};
+
+template <class MakeMode>
+static uint64_t perft(Chessboard& c, int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+    uint64_t numNodes = 0;
+    for (Move& m : c.generateAllLegalMoves()) {
+        MoveUndoInfo undoInfo = MakeMode::make(c, m);
+        numNodes += perft<MakeMode>(c, depth - 1);
+        MakeMode::undo(c, undoInfo);
+    }
+    return numNodes;
+}
+
+template <class MakeMode>
+static int materialSearch(Chessboard& c, int depth, int alpha, int beta, int64_t& numNodes) {
+    numNodes++;
+    if (depth == 0) {
+        static const int values[] = { 100, 300, 300, 500, 900, 0 };
+        int eval = 0;
+        for (int p = Piece::PAWN; p <= Piece::KING; p++) {
+            eval += values[p] * (c.countPieces(c.getTurn(), (Piece)p) - c.countPieces(Players::getEnemy(c.getTurn()), (Piece)p));
+        }
+        return eval;
+    }
+    int best = -100000;
+    for (Move& m : c.generateAllLegalMoves()) {
+        MoveUndoInfo undoInfo = MakeMode::make(c, m);
+        best = std::max(best, -materialSearch<MakeMode>(c, depth - 1, -beta, -std::max(alpha, best), numNodes));
+        MakeMode::undo(c, undoInfo);
+        if (best >= beta) {
+            break;
+        }
+    }
+    return best;
+}
+
+template <class MakeMode>
+static void BM_Perft(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    int64_t numNodes = 0;
+    for (auto _ : state) {
+        for (Chessboard& c : boards) {
+            numNodes += perft<MakeMode>(c, (int)state.range(0));
+        }
+    }
+    state.counters["nodes/s"] = benchmark::Counter((double)numNodes, benchmark::Counter::kIsRate);
+}
+BENCHMARK_TEMPLATE(BM_Perft, CopyMake)->Arg(3)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Perft, MakeUnmake)->Arg(3)->Unit(benchmark::kMillisecond);
+
+template <class MakeMode>
+static void BM_Search(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    int64_t numNodes = 0;
+    for (auto _ : state) {
+        for (Chessboard& c : boards) {
+            benchmark::DoNotOptimize(materialSearch<MakeMode>(c, (int)state.range(0), -100000, 100000, numNodes));
+        }
+    }
+    state.counters["nodes/s"] = benchmark::Counter((double)numNodes, benchmark::Counter::kIsRate);
+}
+BENCHMARK_TEMPLATE(BM_Search, CopyMake)->Arg(4)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Search, MakeUnmake)->Arg(4)->Unit(benchmark::kMillisecond);
+
+static void BM_IsChecked(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    size_t idx = 0;
+    for (auto _ : state) {
+        Chessboard& c = boards[idx];
+        benchmark::DoNotOptimize(c.isChecked(c.getTurn()));
+        idx = (idx + 1) % boards.size();
+    }
+}
+BENCHMARK(BM_IsChecked);
+
+static void BM_GivesCheck(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    std::vector<std::vector<Move>> movesPerBoard;
+    for (Chessboard& c : boards) {
+        movesPerBoard.push_back(c.generateAllLegalMoves());
+    }
+
+    // one iteration = one move, the check info of a position is computed on its first move
+    size_t boardIdx = 0;
+    size_t moveIdx = 0;
+    for (auto _ : state) {
+        Chessboard& c = boards[boardIdx];
+        benchmark::DoNotOptimize(c.givesCheck(movesPerBoard[boardIdx][moveIdx]));
+        moveIdx++;
+        if (moveIdx == movesPerBoard[boardIdx].size()) {
+            moveIdx = 0;
+            boardIdx = (boardIdx + 1) % boards.size();
+        }
+    }
+}
+BENCHMARK(BM_GivesCheck);
+
+static void BM_SEE(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    std::vector<std::pair<size_t, Move>> captures;
+    for (size_t i = 0; i < boards.size(); i++) {
+        for (Move& m : boards[i].generatePseudolegalMoves(GEN_CAPTURES)) {
+            captures.push_back({ i, m });
+        }
+    }
+
+    // one iteration = one capture
+    size_t idx = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(boards[captures[idx].first].see(captures[idx].second));
+        idx = (idx + 1) % captures.size();
+    }
+}
+BENCHMARK(BM_SEE);
+
+static void BM_IsAttacking(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    size_t idx = 0;
+    int sq = Square::A1;
+    for (auto _ : state) {
+        Chessboard& c = boards[idx];
+        benchmark::DoNotOptimize(c.isAttacking(c.getTurn(), (Square)sq));
+        sq++;
+        if (sq == NUM_SQUARES) {
+            sq = Square::A1;
+            idx = (idx + 1) % boards.size();
+        }
+    }
+}
+BENCHMARK(BM_IsAttacking);
+
+static void BM_RookLookup(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    size_t idx = 0;
+    int sq = Square::A1;
+    for (auto _ : state) {
+        Bitboard blockers = Bitboards::ROOK_MASKS[sq] & boards[idx].getAllPieces();
+        benchmark::DoNotOptimize(Bitboards::getRookMoveTable((Square)sq, blockers));
+        sq++;
+        if (sq == NUM_SQUARES) {
+            sq = Square::A1;
+            idx = (idx + 1) % boards.size();
+        }
+    }
+}
+BENCHMARK(BM_RookLookup);
+
+static void BM_BishopLookup(benchmark::State& state) {
+    std::vector<Chessboard> boards = loadCorpus();
+    size_t idx = 0;
+    int sq = Square::A1;
+    for (auto _ : state) {
+        Bitboard blockers = Bitboards::BISHOP_MASKS[sq] & boards[idx].getAllPieces();
+        benchmark::DoNotOptimize(Bitboards::getBishopMoveTable((Square)sq, blockers));
+        sq++;
+        if (sq == NUM_SQUARES) {
+            sq = Square::A1;
+            idx = (idx + 1) % boards.size();
+        }
+    }
+}
+BENCHMARK(BM_BishopLookup);
+
+/***
+ * Probes of random keys in a table much larger than the caches, so nearly every probe misses them.
+ * Arg is whether the table uses large pages, which saves the TLB miss that comes with the cache miss.
+ */
+static void BM_TTProbe(benchmark::State& state) {
+    TranspositionTable tt(0);
+    tt.setLargePages(state.range(0) != 0);
+    tt.resize(256);
+    uint64_t key = 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < 1 << 20; i++) {
+        key ^= key << 13; key ^= key >> 7; key ^= key << 17;
+        tt.store(key, 1, 0, BOUND_EXACT, { Square::A1, Square::A2 });
+    }
+    TTEntry entry;
+    for (auto _ : state) {
+        key ^= key << 13; key ^= key >> 7; key ^= key << 17;
+        benchmark::DoNotOptimize(tt.probe(key, entry));
+    }
+    state.SetLabel(tt.usesLargePages() ? "large pages" : "small pages");
+}
+BENCHMARK(BM_TTProbe)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
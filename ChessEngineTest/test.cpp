@@ -1,6 +1,15 @@
 #include "pch.h"
 
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
 #include "../ChessEngine/Chessboard.h"
+#include "../ChessEngine/ChessEngine.h"
+#include "../ChessEngine/MateSolver.h"
+#include "../ChessEngine/OpeningBook.h"
+#include "../ChessEngine/Tablebase.h"
+#include "../ChessEngine/TranspositionTable.h"
 
 class ChessTestEnvironment : public ::testing::Environment {
 protected:
@@ -231,4 +240,457 @@ TEST(MoveExecution, UndoPromotion) {
     EXPECT_EQ(c.toString(), Chessboard("2k2Q2/8/8/8/8/8/8/2K5 w - - 0 1").toString());
     c.undoMove(m);
     EXPECT_EQ(c.toString(), Chessboard("2k5/5P2/8/8/8/8/8/2K5 w - - 0 1").toString());
-}
\ No newline at end of file
+}
+
+TEST(Serialization, FENRoundTrip) {
+    std::string fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "rnbqkbnr/pp1ppppp/8/1PpP4/8/8/P1P1PPPP/RNBQKBNR w KQkq c6 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    };
+    for (std::string& fen : fens) {
+        EXPECT_EQ(Chessboard(fen).toFEN(), fen);
+    }
+}
+
+TEST(Serialization, PackedRoundTrip) {
+    std::string fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbqkbnr/pp1ppppp/8/1PpP4/8/8/P1P1PPPP/RNBQKBNR w KQkq c6 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 b - - 7 10",
+    };
+    for (std::string& fen : fens) {
+        Chessboard c = Chessboard(fen);
+        PackedPosition packed = c.toPacked();
+        EXPECT_EQ(packed.occupancy, c.getAllPieces());
+        EXPECT_EQ(Chessboard(packed).toFEN(), fen);
+    }
+}
+
+TEST(Tablebase, GenerateAndProbe) {
+    std::string dir = (std::filesystem::temp_directory_path() / "chessengine_tb_test").string();
+    std::filesystem::create_directories(dir);
+    Tablebases tablebases;
+    for (const char* name : Tablebases::SUPPORTED_TABLES) {
+        ASSERT_TRUE(tablebases.generate(name, dir));
+    }
+    ASSERT_EQ(tablebases.load(dir), 3);
+    EXPECT_EQ(tablebases.getCardinality(), 3);
+
+    int value;
+    auto probeFEN = [&](const std::string& fen) {
+        Chessboard c = Chessboard(fen);
+        return tablebases.probe(c, value);
+    };
+    ASSERT_TRUE(probeFEN("7k/8/6K1/8/8/8/8/1Q6 w - - 0 1"));
+    EXPECT_EQ(value, 1); // Qb8#
+    ASSERT_TRUE(probeFEN("Q6k/8/6K1/8/8/8/8/8 b - - 0 1"));
+    EXPECT_EQ(value, -1); // checkmated
+    ASSERT_TRUE(probeFEN("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1"));
+    EXPECT_EQ(value, 0); // stalemate
+    ASSERT_TRUE(probeFEN("8/8/8/8/8/2K5/8/Qk6 b - - 0 1"));
+    EXPECT_EQ(value, 0); // queen is lost
+    ASSERT_TRUE(probeFEN("8/8/8/4k3/8/8/8/R3K3 w - - 0 1"));
+    EXPECT_TRUE(Tablebases::isWin(value));
+    ASSERT_TRUE(probeFEN("1q6/8/8/8/8/6k1/8/7K b - - 0 1"));
+    EXPECT_EQ(value, 1); // Qb1# with the colors flipped
+    ASSERT_TRUE(probeFEN("4k3/8/4P3/4K3/8/8/8/8 w - - 0 1"));
+    EXPECT_EQ(value, 0); // opposition draw
+    ASSERT_TRUE(probeFEN("4k3/8/4K3/4P3/8/8/8/8 b - - 0 1"));
+    EXPECT_TRUE(Tablebases::isLoss(value));
+
+    Chessboard start = Chessboard();
+    EXPECT_FALSE(tablebases.probe(start, value));
+}
+
+TEST(OpeningBook, Keys) {
+    Chessboard c = Chessboard();
+    uint64_t start = OpeningBook::computeKey(c);
+    MoveUndoInfo m = c.makeMove({ E2, E4 });
+    EXPECT_NE(OpeningBook::computeKey(c), start);
+    c.undoMove(m);
+    EXPECT_EQ(OpeningBook::computeKey(c), start);
+
+    // same position through different move orders. the second has an en passant square no pawn can use
+    Chessboard a = Chessboard("rnbqkbnr/pppp1ppp/8/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2");
+    Chessboard b = Chessboard("rnbqkbnr/pppp1ppp/8/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq e3 0 2");
+    EXPECT_EQ(OpeningBook::computeKey(a), OpeningBook::computeKey(b));
+    Chessboard d = Chessboard("rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 2");
+    Chessboard e = Chessboard("rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2");
+    EXPECT_NE(OpeningBook::computeKey(d), OpeningBook::computeKey(e));
+
+    // keys published with the Polyglot format
+    EXPECT_EQ(start, 0x463B96181691FC9Cull);
+    Chessboard f = Chessboard("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3");
+    EXPECT_EQ(OpeningBook::computeKey(f), 0x652A607CA3F242C1ull);
+    Chessboard g = Chessboard("rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4");
+    EXPECT_EQ(OpeningBook::computeKey(g), 0x5C3F9B829B279560ull);
+}
+
+TEST(OpeningBook, BuildAndPick) {
+    std::string path = (std::filesystem::temp_directory_path() / "chessengine_book_test.bin").string();
+    std::stringstream games("e2e4 e7e5 g1f3\ne2e4 c7c5\ne2e4 e7e5 f1c4\nd2d4 d7d5\ne1e2\n");
+    EXPECT_EQ(OpeningBook::build(games, path, 2), 5);
+
+    OpeningBook book;
+    ASSERT_TRUE(book.open(path));
+    EXPECT_EQ(book.size(), 5);
+
+    Chessboard c = Chessboard();
+    std::vector<BookEntry> entries = book.findEntries(OpeningBook::computeKey(c));
+    ASSERT_EQ(entries.size(), 2);
+    int totalWeight = 0;
+    for (BookEntry& entry : entries) {
+        Move m;
+        ASSERT_TRUE(OpeningBook::decodeMove(c, entry.move, m));
+        std::string move = Moves::toString(m);
+        EXPECT_TRUE(move == "e2e4" || move == "d2d4");
+        EXPECT_EQ(entry.weight, move == "e2e4" ? 3 : 1);
+        totalWeight += entry.weight;
+    }
+    EXPECT_EQ(totalWeight, 4);
+
+    std::mt19937_64 rng(0);
+    Move picked;
+    c.makeMove({ E2, E4 });
+    ASSERT_TRUE(book.pickMove(c, rng, picked));
+    EXPECT_TRUE(Moves::toString(picked) == "e7e5" || Moves::toString(picked) == "c7c5");
+    c.makeMove(picked);
+    EXPECT_FALSE(book.pickMove(c, rng, picked)); // beyond the stored plies
+}
+
+TEST(OpeningBook, CastlingMoveFormat) {
+    Chessboard c = Chessboard("r3k2r/pppppppp/8/8/8/8/PPPPPPPP/R3K2R w KQkq - 0 1");
+    Move castle = { E1, G1 };
+    uint16_t bookMove = OpeningBook::encodeMove(c, castle);
+    EXPECT_EQ(bookMove, (uint16_t)(FILE_H | (RANK_1 << 3) | (FILE_E << 6) | (RANK_1 << 9)));
+    Move decoded;
+    ASSERT_TRUE(OpeningBook::decodeMove(c, bookMove, decoded));
+    EXPECT_EQ(decoded.to, G1);
+}
+
+/***
+ * Checks that the incrementally updated hash matches the hash of the same position loaded from scratch
+ */
+static void checkHashes(Chessboard& c, int depth) {
+    EXPECT_EQ(c.getHash(), Chessboard(c.toFEN()).getHash()) << c.toFEN();
+    if (depth == 0) {
+        return;
+    }
+    for (Move& m : c.generateAllLegalMoves()) {
+        MoveUndoInfo undoInfo = c.makeMove(m);
+        checkHashes(c, depth - 1);
+        c.undoMove(undoInfo);
+    }
+}
+
+TEST(Hashing, IncrementalMatchesFromScratch) {
+    std::string fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbqkbnr/pp1ppppp/8/1PpP4/8/8/P1P1PPPP/RNBQKBNR w KQkq c6 0 1",
+    };
+    for (std::string& fen : fens) {
+        Chessboard c = Chessboard(fen);
+        uint64_t before = c.getHash();
+        checkHashes(c, 2);
+        EXPECT_EQ(c.getHash(), before);
+    }
+
+    // transpositions reach the same hash
+    Chessboard a = Chessboard();
+    a.makeMove({ G1, F3 });
+    a.makeMove({ G8, F6 });
+    a.makeMove({ B1, C3 });
+    Chessboard b = Chessboard();
+    b.makeMove({ B1, C3 });
+    b.makeMove({ G8, F6 });
+    b.makeMove({ G1, F3 });
+    EXPECT_EQ(a.getHash(), b.getHash());
+}
+
+TEST(TranspositionTable, StoreAndProbe) {
+    TranspositionTable tt(1);
+    Chessboard c = Chessboard();
+    TTEntry entry;
+    EXPECT_FALSE(tt.probe(c.getHash(), entry));
+
+    tt.store(c.getHash(), 4, 25, BOUND_EXACT, { E2, E4 });
+    ASSERT_TRUE(tt.probe(c.getHash(), entry));
+    EXPECT_EQ(entry.depth, 4);
+    EXPECT_EQ(entry.score, 25);
+    Move m = TranspositionTable::unpackMove(entry.move);
+    EXPECT_EQ(Moves::toString(m), "e2e4");
+
+    // shallower results don't replace deeper ones for the same position
+    tt.store(c.getHash(), 2, -10, BOUND_LOWER, { D2, D4 });
+    ASSERT_TRUE(tt.probe(c.getHash(), entry));
+    EXPECT_EQ(entry.depth, 4);
+
+    Move promotion = TranspositionTable::unpackMove(TranspositionTable::packMove({ B7, A8, Piece::QUEEN }));
+    EXPECT_EQ(Moves::toString(promotion), "b7a8q");
+
+    tt.clear();
+    EXPECT_FALSE(tt.probe(c.getHash(), entry));
+}
+
+TEST(TranspositionTable, SaveAndLoad) {
+    std::string path = (std::filesystem::temp_directory_path() / "chessengine_tt_test.bin").string();
+    Chessboard c = Chessboard();
+    TranspositionTable saved(1);
+    saved.store(c.getHash(), 6, -40, BOUND_LOWER, { G1, F3 });
+    ASSERT_TRUE(saved.save(path));
+
+    // the loaded table takes the size that was saved
+    TranspositionTable loaded(2);
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_EQ(loaded.sizeMB(), 1);
+    TTEntry entry;
+    ASSERT_TRUE(loaded.probe(c.getHash(), entry));
+    EXPECT_EQ(entry.depth, 6);
+    EXPECT_EQ(entry.score, -40);
+    EXPECT_EQ(entry.bound, BOUND_LOWER);
+
+    // a corrupted file is rejected and leaves the table as it was
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(100);
+        file.put('x');
+    }
+    TranspositionTable rejected(1);
+    EXPECT_FALSE(rejected.load(path));
+    EXPECT_FALSE(rejected.probe(c.getHash(), entry));
+    EXPECT_FALSE(rejected.load(path + ".missing"));
+}
+
+TEST(Repetition, Detection) {
+    Chessboard c = Chessboard();
+    Move shuffle[] = { { G1, F3 }, { G8, F6 }, { F3, G1 }, { F6, G8 } };
+    for (Move& m : shuffle) {
+        EXPECT_FALSE(c.isRepetition());
+        c.makeMove(m);
+    }
+    EXPECT_TRUE(c.isRepetition());
+
+    // black can repeat the starting position with its next move
+    Chessboard d = Chessboard();
+    for (int i = 0; i < 3; i++) {
+        d.makeMove(shuffle[i]);
+    }
+    EXPECT_TRUE(d.hasUpcomingRepetition(4));
+    EXPECT_FALSE(d.hasUpcomingRepetition(3)); // the repeated position is before the start of the line
+
+    // a pawn move can't be undone, so earlier positions can't repeat
+    Chessboard e = Chessboard();
+    e.makeMove({ G1, F3 });
+    e.makeMove({ E7, E5 });
+    e.makeMove({ F3, G1 });
+    EXPECT_FALSE(e.hasUpcomingRepetition(10));
+
+    EXPECT_TRUE(Chessboard("8/8/8/4k3/8/8/8/R3K3 w - - 100 80").isFiftyMoveDraw());
+    EXPECT_FALSE(Chessboard("8/8/8/4k3/8/8/8/R3K3 w - - 99 80").isFiftyMoveDraw());
+}
+
+TEST(Repetition, Between) {
+    EXPECT_EQ(Bitboards::BETWEEN[A1][D4], Bitboards::oneAt(B2) | Bitboards::oneAt(C3));
+    EXPECT_EQ(Bitboards::BETWEEN[H8][H5], Bitboards::oneAt(H7) | Bitboards::oneAt(H6));
+    EXPECT_EQ(Bitboards::BETWEEN[A1][B3], 0);
+    EXPECT_EQ(Bitboards::BETWEEN[E4][E5], 0);
+}
+
+TEST(Serialization, MoveFromString) {
+    Move m;
+    ASSERT_TRUE(Moves::fromString("e2e4", m));
+    EXPECT_EQ(m.from, E2);
+    EXPECT_EQ(m.to, E4);
+    EXPECT_EQ(m.promotion, Piece::PIECE_NONE);
+    ASSERT_TRUE(Moves::fromString("b7a8n", m));
+    EXPECT_EQ(m.to, A8);
+    EXPECT_EQ(m.promotion, Piece::KNIGHT);
+    EXPECT_FALSE(Moves::fromString("e2e", m));
+    EXPECT_FALSE(Moves::fromString("e2e9", m));
+    EXPECT_FALSE(Moves::fromString("e7e8k", m));
+}
+
+TEST(Search, MultiPV) {
+    // white can take the queen, the rook or the knight
+    ChessEngine engine;
+    engine.loadFEN("k7/pp6/8/8/q4rn1/1P2P2P/8/7K w - - 0 1");
+    engine.setMultiPV(3);
+    Move best = engine.search(3);
+
+    std::vector<SearchLine> lines = engine.getLines();
+    ASSERT_EQ(lines.size(), 3);
+    EXPECT_EQ(Moves::toString(best), "b3a4");
+    EXPECT_EQ(Moves::toString(lines[0].moves[0]), "b3a4");
+    EXPECT_EQ(Moves::toString(lines[1].moves[0]), "e3f4");
+    EXPECT_EQ(Moves::toString(lines[2].moves[0]), "h3g4");
+    EXPECT_GE(lines[0].eval, lines[1].eval);
+    EXPECT_GE(lines[1].eval, lines[2].eval);
+}
+
+TEST(Search, MateSearch) {
+    ChessEngine engine;
+
+    // back rank mate in 1
+    engine.loadFEN("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+    Move mate = engine.searchMate(1);
+    EXPECT_EQ(Moves::toString(mate), "a1a8");
+
+    // Nf6+ gxf6 Bxf7#
+    engine.loadFEN("r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1");
+    EXPECT_EQ(engine.searchMate(1).from, Square::SQUARE_NONE);
+    mate = engine.searchMate(2);
+    EXPECT_EQ(Moves::toString(mate), "d5f6");
+    EXPECT_EQ(engine.getPrincipalVariation().size(), 3);
+}
+
+TEST(MateSolver, ProvesAndDisproves) {
+    // Nf6+ gxf6 Bxf7#
+    Chessboard board("r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1");
+    MateSolver solver(1);
+
+    MateSolution solution = solver.solve(board, 1);
+    EXPECT_EQ(solution.result, ProofResult::DISPROVEN);
+
+    solution = solver.solve(board, 2);
+    ASSERT_EQ(solution.result, ProofResult::PROVEN);
+    ASSERT_EQ(solution.pv.size(), 3);
+    EXPECT_EQ(Moves::toString(solution.pv[0]), "d5f6");
+    EXPECT_EQ(Moves::toString(solution.pv[2]), "c4f7");
+
+    solution = solver.solve(board, 2, 4);
+    ASSERT_EQ(solution.result, ProofResult::PROVEN);
+    EXPECT_EQ(solution.pv.size(), 3);
+
+    // the node limit stops the search before anything is proven
+    solution = solver.solve(board, 2, 1, 5);
+    EXPECT_EQ(solution.result, ProofResult::UNKNOWN);
+}
+
+TEST(MoveGeneration, GenTypes) {
+    auto key = [](const Move& m) { return m.from * 64 * 8 + m.to * 8 + m.promotion; };
+    auto keys = [&](const std::vector<Move>& moves) {
+        std::vector<int> out;
+        for (const Move& m : moves) {
+            out.push_back(key(m));
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    };
+
+    const char* fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "rnbqkbnr/pp1ppppp/8/1PpP4/8/8/P1P1PPPP/RNBQKBNR w KQkq c6 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 b kq - 0 1",
+    };
+    for (const char* fen : fens) {
+        Chessboard board(fen);
+        std::vector<Move> captures = board.generatePseudolegalMoves(GEN_CAPTURES);
+        std::vector<Move> quiets = board.generatePseudolegalMoves(GEN_QUIETS);
+        for (Move& m : captures) {
+            EXPECT_TRUE(m.isCapture || m.promotion != Piece::PIECE_NONE) << fen << " " << Moves::toString(m);
+        }
+        for (Move& m : quiets) {
+            EXPECT_FALSE(m.isCapture || m.promotion != Piece::PIECE_NONE) << fen << " " << Moves::toString(m);
+        }
+        captures.insert(captures.end(), quiets.begin(), quiets.end());
+        EXPECT_EQ(keys(captures), keys(board.generateAllPseudolegalMoves())) << fen;
+    }
+
+    // in check, every legal move is an evasion
+    Chessboard checked("4k3/8/8/8/1b6/8/2P5/R3K1N1 w - - 0 1");
+    std::vector<Move> legal;
+    for (Move& m : checked.generateAllPseudolegalMoves()) {
+        MoveUndoInfo undoInfo = checked.makeMove(m);
+        if (!checked.isChecked(Player::WHITE)) {
+            legal.push_back(m);
+        }
+        checked.undoMove(undoInfo);
+    }
+    std::vector<Move> evasions = checked.generatePseudolegalMoves(GEN_EVASIONS);
+    std::vector<int> evasionKeys = keys(evasions);
+    for (Move& m : legal) {
+        EXPECT_TRUE(std::binary_search(evasionKeys.begin(), evasionKeys.end(), key(m))) << Moves::toString(m);
+    }
+    EXPECT_EQ(keys(checked.generateAllLegalMoves()), keys(legal));
+}
+
+TEST(MoveGeneration, StateInfo) {
+    // the bishop on a4 covers d1, so white can only castle kingside, and the rook on e8 pins the bishop on e2
+    Chessboard board("4r1k1/8/8/8/b7/8/4B3/R3K2R w KQ - 0 1");
+    EXPECT_EQ(board.getCheckers(), 0);
+    EXPECT_EQ(board.getPinned(), Bitboards::oneAt(Square::E2));
+    EXPECT_TRUE(Bitboards::contains(board.getEnemyAttacks(), Square::D1));
+
+    std::vector<Move> moves = board.generateAllLegalMoves();
+    bool kingside = false;
+    bool queenside = false;
+    for (Move& m : moves) {
+        EXPECT_NE(m.from, Square::E2) << Moves::toString(m);
+        kingside |= m.from == Square::E1 && m.to == Square::G1;
+        queenside |= m.from == Square::E1 && m.to == Square::C1;
+    }
+    EXPECT_TRUE(kingside);
+    EXPECT_FALSE(queenside);
+
+    // the state kept by makeMove matches the state computed from scratch
+    for (Move& m : moves) {
+        MoveUndoInfo undoInfo = board.makeMove(m);
+        Chessboard fromScratch(board.toFEN());
+        EXPECT_EQ(board.getCheckers(), fromScratch.getCheckers()) << Moves::toString(m);
+        EXPECT_EQ(board.getPinned(), fromScratch.getPinned()) << Moves::toString(m);
+        EXPECT_EQ(board.getEnemyAttacks(), fromScratch.getEnemyAttacks()) << Moves::toString(m);
+        board.undoMove(undoInfo);
+    }
+}
+
+TEST(MoveGeneration, GivesCheck) {
+    std::string fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "4k3/8/8/4N3/8/8/8/4R1K1 w - - 0 1",   // discovered checks
+        "5k2/8/8/8/8/8/8/4K2R w K - 0 1",      // castling checks with the rook
+        "3k4/1P6/8/8/8/8/8/4K3 w - - 0 1",     // promotions
+        "8/8/8/k2pP2R/8/8/8/4K3 w - d6 0 1",   // en passant uncovers the rook
+    };
+    for (std::string& fen : fens) {
+        Chessboard board(fen);
+        for (Move& m : board.generateAllLegalMoves()) {
+            MoveUndoInfo undoInfo = board.makeMove(m);
+            bool check = board.isChecked(board.getTurn());
+            board.undoMove(undoInfo);
+            EXPECT_EQ(board.givesCheck(m), check) << fen << " " << Moves::toString(m);
+        }
+    }
+}
+
+TEST(StaticExchange, KnownPositions) {
+    struct SEECase {
+        std::string fen;
+        std::string move;
+        int expected;
+    };
+    SEECase cases[] = {
+        { "1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1e5", 100 },            // undefended pawn
+        { "1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1", "d3e5", -200 }, // knight for a pawn
+        { "4k3/8/3p4/4p3/8/8/8/4QK2 w - - 0 1", "e1e5", -800 },                       // queen takes a defended pawn
+        { "4k3/8/3p4/4r3/8/3N4/8/4K3 w - - 0 1", "d3e5", 200 },                       // knight takes a defended rook
+        { "4r1k1/4r3/8/4p3/8/8/4R3/4R1K1 w - - 0 1", "e2e5", -400 },                  // x-rays on both sides
+        { "8/8/8/3pk3/4P3/8/8/3RK3 w - - 0 1", "e4d5", 100 },                          // the king can't recapture
+        { "4k3/8/8/8/8/8/4p3/3RK3 b - - 0 1", "e2d1q", 400 },                          // promoting onto a rook, lost to the king
+        { "3rk3/8/8/8/8/8/4p3/3RK3 b - - 0 1", "e2d1q", 1300 },                        // and kept when a rook defends it
+        { "4k3/8/8/8/8/2b5/8/R3K3 w - - 0 1", "a1a7", 0 },                              // quiet move to a safe square
+        { "4k3/8/8/1b6/8/8/8/R3K3 w - - 0 1", "a1a4", -500 },                            // quiet move onto an attacked square
+    };
+    for (SEECase& c : cases) {
+        Chessboard board(c.fen);
+        Move m;
+        ASSERT_TRUE(Moves::fromString(c.move, m));
+        EXPECT_EQ(board.see(m), c.expected) << c.fen << " " << c.move;
+    }
+}